@@ -0,0 +1,105 @@
+//
+//  SndCtlArena.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlArena.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Enough for any type the arena hands out.
+#define kSndCtlArenaAlignment 16
+
+typedef struct SndCtlArenaChunk {
+	struct SndCtlArenaChunk *next;
+	size_t capacity;
+	size_t used;
+	unsigned char bytes[] __attribute__((aligned(kSndCtlArenaAlignment)));
+} SndCtlArenaChunk;
+
+struct SndCtlArena {
+	/// The chunk being allocated from; older, full chunks follow it.
+	SndCtlArenaChunk *chunks;
+	size_t chunkCapacity;
+};
+
+static const size_t kSndCtlArenaMinimumChunkCapacity = 1024;
+
+static size_t SndCtlArenaAlignedSize(size_t size) {
+	return (size + kSndCtlArenaAlignment - 1) & ~(size_t)(kSndCtlArenaAlignment - 1);
+}
+
+static SndCtlArenaChunk *SndCtlArenaChunkCreate(size_t capacity) {
+	SndCtlArenaChunk *chunk = calloc(1, sizeof(SndCtlArenaChunk) + capacity);
+
+	if (chunk)
+		chunk->capacity = capacity;
+
+	return chunk;
+}
+
+SndCtlArenaRef SndCtlArenaCreate(size_t capacity) {
+	if (capacity < kSndCtlArenaMinimumChunkCapacity)
+		capacity = kSndCtlArenaMinimumChunkCapacity;
+
+	// The arena's bookkeeping lives at the start of its own first chunk.
+	size_t headerSize = SndCtlArenaAlignedSize(sizeof(struct SndCtlArena));
+	SndCtlArenaChunk *chunk = SndCtlArenaChunkCreate(headerSize + capacity);
+
+	if (!chunk)
+		return NULL;
+
+	SndCtlArenaRef arena = (SndCtlArenaRef)chunk->bytes;
+	chunk->used = headerSize;
+	arena->chunks = chunk;
+	arena->chunkCapacity = capacity;
+
+	return arena;
+}
+
+void SndCtlArenaRelease(SndCtlArenaRef arena) {
+	if (!arena)
+		return;
+
+	SndCtlArenaChunk *chunk = arena->chunks;
+
+	while (chunk) {
+		SndCtlArenaChunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+}
+
+void *SndCtlArenaAlloc(SndCtlArenaRef arena, size_t size) {
+	size_t alignedSize = SndCtlArenaAlignedSize(size);
+	SndCtlArenaChunk *chunk = arena->chunks;
+
+	if (chunk->capacity - chunk->used < alignedSize) {
+		size_t capacity = alignedSize > arena->chunkCapacity ? alignedSize : arena->chunkCapacity;
+		SndCtlArenaChunk *newChunk = SndCtlArenaChunkCreate(capacity);
+
+		if (!newChunk)
+			return NULL;
+
+		newChunk->next = chunk;
+		arena->chunks = chunk = newChunk;
+	}
+
+	void *memory = chunk->bytes + chunk->used;
+	chunk->used += alignedSize;
+
+	return memory;
+}
+
+char *SndCtlArenaCopyString(SndCtlArenaRef arena, const char *string) {
+	size_t length = strlen(string) + 1;
+	char *copy = SndCtlArenaAlloc(arena, length);
+
+	if (copy)
+		memcpy(copy, string, length);
+
+	return copy;
+}
@@ -0,0 +1,48 @@
+//
+//  SndCtlArena.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlArena_h
+#define SndCtlArena_h
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/**
+ A bump allocator whose allocations are all freed at once.
+
+ Used for short-lived snapshots like device tables, so building and throwing one away costs a
+ single \c malloc and \c free in the common case no matter how many devices and strings it holds.
+ Arenas aren't thread-safe.
+ */
+typedef struct SndCtlArena *SndCtlArenaRef;
+
+/**
+ Create an arena.
+ @param capacity	The expected total size of all allocations. The arena grows past it if needed.
+ @return A new arena, or \c NULL if it couldn't be allocated. Free it with \c SndCtlArenaRelease()\n.
+ */
+SndCtlArenaRef SndCtlArenaCreate(size_t capacity);
+
+/**
+ Free an arena and everything allocated from it.
+ */
+void SndCtlArenaRelease(SndCtlArenaRef arena);
+
+/**
+ Allocate zeroed, suitably aligned memory from an arena.
+ @return The memory, or \c NULL if the arena needed to grow and couldn't.
+ */
+void *SndCtlArenaAlloc(SndCtlArenaRef arena, size_t size);
+
+/**
+ Copy a C string into an arena.
+ @return The copy, or \c NULL if there wasn't room for it.
+ */
+char *SndCtlArenaCopyString(SndCtlArenaRef arena, const char *string);
+
+#endif /* SndCtlArena_h */
@@ -0,0 +1,409 @@
+//
+//  SndCtlAsync.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlAsync.h"
+#include "SndCtlError.h"
+#include "SndCtlHAL.h"
+#include <pthread.h>
+
+typedef enum {
+	SndCtlAsyncOperationSetVolume,
+	SndCtlAsyncOperationSetBalance,
+	SndCtlAsyncOperationSetSampleRate,
+	SndCtlAsyncOperationSetBufferFrameSize,
+	SndCtlAsyncOperationSetDefaultOutputDevice,
+	SndCtlAsyncOperationGetVolume,
+	SndCtlAsyncOperationGetBalance,
+	SndCtlAsyncOperationCount,
+} SndCtlAsyncOperation;
+
+typedef enum {
+	SndCtlAsyncStatePending,
+	SndCtlAsyncStateRunning,
+	SndCtlAsyncStateFinished,
+} SndCtlAsyncState;
+
+typedef struct SndCtlAsyncWorker SndCtlAsyncWorker;
+
+struct SndCtlAsyncRequest {
+	unsigned retainCount;
+	SndCtlAsyncState state;
+	SndCtlAsyncOperation operation;
+	SndCtlAsyncWorker *worker;
+	AudioObjectID deviceid;
+	Float64 value;
+
+	dispatch_queue_t completionQueue;
+	SndCtlAsyncCompletionHandler handler;
+	void *context;
+
+	// Filled in just before the handler is called.
+	bool success;
+	CFErrorRef error;
+};
+
+/// A serial queue for one device, and the latest still-pending set of each kind.
+struct SndCtlAsyncWorker {
+	AudioObjectID deviceid;
+	dispatch_queue_t queue;
+	SndCtlAsyncRequestRef pending[SndCtlAsyncOperationCount];
+	/// Requests on \c queue that haven't run yet, including cancelled and superseded ones, plus
+	/// the deliveries of abandoned requests' handlers.
+	unsigned queuedCount;
+	/// The device has gone away, so the worker is freed as soon as it's idle.
+	bool deviceGone;
+	SndCtlAsyncWorker *next;
+};
+
+// Guards the worker list and every request's state and retain count.
+static pthread_mutex_t gAsyncLock = PTHREAD_MUTEX_INITIALIZER;
+static SndCtlAsyncWorker *gWorkers = NULL;
+static pthread_once_t gAsyncListenerOnce = PTHREAD_ONCE_INIT;
+
+static const AudioObjectPropertyAddress kSndCtlAsyncDevicesAddress = {
+	kAudioHardwarePropertyDevices,
+	kAudioObjectPropertyScopeGlobal,
+	kAudioObjectPropertyElementMaster
+};
+
+static bool SndCtlAsyncOperationIsSupersedable(SndCtlAsyncOperation operation) {
+	return operation != SndCtlAsyncOperationGetVolume && operation != SndCtlAsyncOperationGetBalance;
+}
+
+// Must be called with gAsyncLock held.
+static SndCtlAsyncWorker *SndCtlAsyncWorkerForDeviceID(AudioObjectID deviceid) {
+	for (SndCtlAsyncWorker *worker = gWorkers; worker; worker = worker->next) {
+		if (worker->deviceid == deviceid)
+			return worker;
+	}
+
+	char label[64];
+	snprintf(label, sizeof(label), "org.derailer.sndctl.device.%u", deviceid);
+
+	SndCtlAsyncWorker *worker = calloc(1, sizeof(SndCtlAsyncWorker));
+	worker->deviceid = deviceid;
+	worker->queue = dispatch_queue_create(label, DISPATCH_QUEUE_SERIAL);
+	worker->next = gWorkers;
+	gWorkers = worker;
+
+	return worker;
+}
+
+// Must be called with gAsyncLock held. Returns the worker if it should be freed, which the caller
+// does with SndCtlAsyncWorkerFree() once the lock is dropped.
+static SndCtlAsyncWorker *SndCtlAsyncWorkerUnlinkIfIdleLocked(SndCtlAsyncWorker *worker) {
+	if (!worker->deviceGone || worker->queuedCount > 0)
+		return NULL;
+
+	for (SndCtlAsyncWorker **link = &gWorkers; *link; link = &(*link)->next) {
+		if (*link == worker) {
+			*link = worker->next;
+			return worker;
+		}
+	}
+
+	return NULL;
+}
+
+static void SndCtlAsyncWorkerFree(SndCtlAsyncWorker *worker) {
+	if (!worker)
+		return;
+
+	// Fine even from the worker's own last block, which keeps the queue alive until it returns.
+	dispatch_release(worker->queue);
+	free(worker);
+}
+
+// Frees the workers of devices that have gone away, or marks them to be freed once their queued
+// requests have run.
+static OSStatus SndCtlAsyncDevicesListener(AudioObjectID objectid, UInt32 addressCount, const AudioObjectPropertyAddress *addresses, void *clientData) {
+	UInt32 size = 0;
+
+	if (SndCtlHALGetPropertyDataSize(kAudioObjectSystemObject, &kSndCtlAsyncDevicesAddress, 0, NULL, &size) != kAudioHardwareNoError)
+		return kAudioHardwareNoError;
+
+	AudioObjectID *deviceids = malloc(size > 0 ? size : 1);
+
+	if (SndCtlHALGetPropertyData(kAudioObjectSystemObject, &kSndCtlAsyncDevicesAddress, 0, NULL, &size, deviceids) != kAudioHardwareNoError) {
+		free(deviceids);
+		return kAudioHardwareNoError;
+	}
+
+	UInt32 deviceCount = size / sizeof(AudioObjectID);
+	SndCtlAsyncWorker *freed = NULL;
+
+	pthread_mutex_lock(&gAsyncLock);
+
+	for (SndCtlAsyncWorker **link = &gWorkers; *link; ) {
+		SndCtlAsyncWorker *worker = *link;
+		bool present = worker->deviceid == kAudioObjectSystemObject;
+
+		for (UInt32 i = 0; i < deviceCount && !present; ++i)
+			present = deviceids[i] == worker->deviceid;
+
+		worker->deviceGone = !present;
+
+		if (worker->deviceGone && worker->queuedCount == 0) {
+			*link = worker->next;
+			worker->next = freed;
+			freed = worker;
+		} else
+			link = &worker->next;
+	}
+
+	pthread_mutex_unlock(&gAsyncLock);
+
+	while (freed) {
+		SndCtlAsyncWorker *next = freed->next;
+		SndCtlAsyncWorkerFree(freed);
+		freed = next;
+	}
+
+	free(deviceids);
+
+	return kAudioHardwareNoError;
+}
+
+static void SndCtlAsyncStartListening(void) {
+	SndCtlHALAddPropertyListener(kAudioObjectSystemObject, &kSndCtlAsyncDevicesAddress, SndCtlAsyncDevicesListener, NULL);
+}
+
+// Must be called with gAsyncLock held.
+static void SndCtlAsyncRequestReleaseLocked(SndCtlAsyncRequestRef request) {
+	if (--request->retainCount > 0)
+		return;
+
+	if (request->completionQueue)
+		dispatch_release(request->completionQueue);
+
+	free(request);
+}
+
+void SndCtlAsyncRequestRelease(SndCtlAsyncRequestRef request) {
+	if (!request)
+		return;
+
+	pthread_mutex_lock(&gAsyncLock);
+	SndCtlAsyncRequestReleaseLocked(request);
+	pthread_mutex_unlock(&gAsyncLock);
+}
+
+static void SndCtlAsyncDeliver(void *context) {
+	SndCtlAsyncRequestRef request = context;
+
+	if (request->handler)
+		request->handler(request->success, request->value, request->error, request->context);
+
+	if (request->error)
+		CFRelease(request->error);
+
+	SndCtlAsyncRequestRelease(request);
+}
+
+static void SndCtlAsyncDeliverOnWorker(void *context) {
+	SndCtlAsyncRequestRef request = context;
+	SndCtlAsyncWorker *worker = request->worker;
+
+	SndCtlAsyncDeliver(request);
+
+	pthread_mutex_lock(&gAsyncLock);
+	--worker->queuedCount;
+	SndCtlAsyncWorker *freed = SndCtlAsyncWorkerUnlinkIfIdleLocked(worker);
+	pthread_mutex_unlock(&gAsyncLock);
+
+	SndCtlAsyncWorkerFree(freed);
+}
+
+// Takes over the caller's reference to the request. Without a completion queue the handler is
+// called on the worker's queue, directly if onWorkerQueue and otherwise from a block counted by
+// SndCtlAsyncAbandonLocked().
+static void SndCtlAsyncFinish(SndCtlAsyncRequestRef request, bool success, CFErrorRef error, bool onWorkerQueue) {
+	request->success = success;
+	request->error = error;
+
+	if (request->completionQueue)
+		dispatch_async_f(request->completionQueue, request, SndCtlAsyncDeliver);
+	else if (onWorkerQueue)
+		SndCtlAsyncDeliver(request);
+	else
+		dispatch_async_f(request->worker->queue, request, SndCtlAsyncDeliverOnWorker);
+}
+
+// Must be called with gAsyncLock held. Marks a pending request as finished, keeping it (and, if
+// its handler will be called on the worker's queue, the worker) alive for SndCtlAsyncFinish().
+static void SndCtlAsyncAbandonLocked(SndCtlAsyncRequestRef request) {
+	request->state = SndCtlAsyncStateFinished;
+	++request->retainCount;
+
+	if (!request->completionQueue)
+		++request->worker->queuedCount;
+}
+
+static CFErrorRef SndCtlAsyncCreateAbandonedError(SndCtlErrorCode code) {
+	return SndCtlErrorCreate(code, code == SndCtlErrorSuperseded ? CFSTR("The request was superseded by a newer one.") : CFSTR("The request was cancelled."));
+}
+
+static void SndCtlAsyncRun(void *context) {
+	SndCtlAsyncRequestRef request = context;
+	SndCtlAsyncWorker *worker = request->worker;
+
+	pthread_mutex_lock(&gAsyncLock);
+
+	// Cancelled or superseded while waiting; its handler has already been called.
+	if (request->state != SndCtlAsyncStatePending) {
+		--worker->queuedCount;
+		SndCtlAsyncWorker *freed = SndCtlAsyncWorkerUnlinkIfIdleLocked(worker);
+		SndCtlAsyncRequestReleaseLocked(request);
+		pthread_mutex_unlock(&gAsyncLock);
+
+		SndCtlAsyncWorkerFree(freed);
+		return;
+	}
+
+	request->state = SndCtlAsyncStateRunning;
+
+	if (worker->pending[request->operation] == request)
+		worker->pending[request->operation] = NULL;
+
+	pthread_mutex_unlock(&gAsyncLock);
+
+	AudioObjectID deviceid = request->deviceid;
+	CFErrorRef error = NULL;
+	bool success = false;
+
+	switch (request->operation) {
+		case SndCtlAsyncOperationSetVolume:
+			success = SndCtlSetVolume(deviceid, (Float32)request->value, &error);
+			break;
+		case SndCtlAsyncOperationSetBalance:
+			success = SndCtlSetBalance(deviceid, (Float32)request->value, &error);
+			break;
+		case SndCtlAsyncOperationSetSampleRate:
+			success = SndCtlSetNominalSampleRate(deviceid, request->value, &error);
+			break;
+		case SndCtlAsyncOperationSetBufferFrameSize:
+			success = SndCtlSetBufferFrameSize(deviceid, (UInt32)request->value, &error);
+			break;
+		case SndCtlAsyncOperationSetDefaultOutputDevice:
+			success = SndCtlSetDefaultOutputDeviceID(deviceid, &error);
+			break;
+		case SndCtlAsyncOperationGetVolume:
+			request->value = SndCtlGetVolume(deviceid, &error);
+			success = !isnan(request->value);
+			break;
+		case SndCtlAsyncOperationGetBalance:
+			request->value = SndCtlGetBalance(deviceid, &error);
+			success = !isnan(request->value);
+			break;
+		case SndCtlAsyncOperationCount:
+			break;
+	}
+
+	pthread_mutex_lock(&gAsyncLock);
+	request->state = SndCtlAsyncStateFinished;
+	--worker->queuedCount;
+	SndCtlAsyncWorker *freed = SndCtlAsyncWorkerUnlinkIfIdleLocked(worker);
+	pthread_mutex_unlock(&gAsyncLock);
+
+	SndCtlAsyncFinish(request, success, error, true);
+	SndCtlAsyncWorkerFree(freed);
+}
+
+static SndCtlAsyncRequestRef SndCtlAsyncSubmit(SndCtlAsyncOperation operation, AudioObjectID deviceid, Float64 value, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context) {
+	SndCtlAsyncRequestRef request = calloc(1, sizeof(struct SndCtlAsyncRequest));
+	request->retainCount = 2; // One for the caller, one for the queue.
+	request->state = SndCtlAsyncStatePending;
+	request->operation = operation;
+	request->deviceid = deviceid;
+	request->value = value;
+	request->completionQueue = completionQueue;
+	request->handler = handler;
+	request->context = context;
+
+	if (completionQueue)
+		dispatch_retain(completionQueue);
+
+	// The default device is a property of the system object, so those sets share a queue.
+	AudioObjectID workerid = operation == SndCtlAsyncOperationSetDefaultOutputDevice ? kAudioObjectSystemObject : deviceid;
+	SndCtlAsyncRequestRef superseded = NULL;
+
+	// Outside the lock, since the listener takes it.
+	pthread_once(&gAsyncListenerOnce, SndCtlAsyncStartListening);
+
+	pthread_mutex_lock(&gAsyncLock);
+
+	SndCtlAsyncWorker *worker = SndCtlAsyncWorkerForDeviceID(workerid);
+	request->worker = worker;
+	++worker->queuedCount;
+
+	if (SndCtlAsyncOperationIsSupersedable(operation)) {
+		superseded = worker->pending[operation];
+
+		if (superseded)
+			SndCtlAsyncAbandonLocked(superseded);
+
+		worker->pending[operation] = request;
+	}
+
+	pthread_mutex_unlock(&gAsyncLock);
+
+	if (superseded)
+		SndCtlAsyncFinish(superseded, false, SndCtlAsyncCreateAbandonedError(SndCtlErrorSuperseded), false);
+
+	dispatch_async_f(worker->queue, request, SndCtlAsyncRun);
+
+	return request;
+}
+
+bool SndCtlAsyncRequestCancel(SndCtlAsyncRequestRef request) {
+	pthread_mutex_lock(&gAsyncLock);
+
+	if (request->state != SndCtlAsyncStatePending) {
+		pthread_mutex_unlock(&gAsyncLock);
+		return false;
+	}
+
+	SndCtlAsyncAbandonLocked(request);
+
+	if (request->worker->pending[request->operation] == request)
+		request->worker->pending[request->operation] = NULL;
+
+	pthread_mutex_unlock(&gAsyncLock);
+
+	SndCtlAsyncFinish(request, false, SndCtlAsyncCreateAbandonedError(SndCtlErrorCancelled), false);
+
+	return true;
+}
+
+SndCtlAsyncRequestRef SndCtlSetVolumeAsync(AudioObjectID deviceid, Float32 volume, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context) {
+	return SndCtlAsyncSubmit(SndCtlAsyncOperationSetVolume, deviceid, volume, completionQueue, handler, context);
+}
+
+SndCtlAsyncRequestRef SndCtlSetBalanceAsync(AudioObjectID deviceid, Float32 balance, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context) {
+	return SndCtlAsyncSubmit(SndCtlAsyncOperationSetBalance, deviceid, balance, completionQueue, handler, context);
+}
+
+SndCtlAsyncRequestRef SndCtlSetNominalSampleRateAsync(AudioObjectID deviceid, Float64 sampleRate, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context) {
+	return SndCtlAsyncSubmit(SndCtlAsyncOperationSetSampleRate, deviceid, sampleRate, completionQueue, handler, context);
+}
+
+SndCtlAsyncRequestRef SndCtlSetBufferFrameSizeAsync(AudioObjectID deviceid, UInt32 frames, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context) {
+	return SndCtlAsyncSubmit(SndCtlAsyncOperationSetBufferFrameSize, deviceid, frames, completionQueue, handler, context);
+}
+
+SndCtlAsyncRequestRef SndCtlSetDefaultOutputDeviceIDAsync(AudioObjectID deviceid, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context) {
+	return SndCtlAsyncSubmit(SndCtlAsyncOperationSetDefaultOutputDevice, deviceid, deviceid, completionQueue, handler, context);
+}
+
+SndCtlAsyncRequestRef SndCtlGetVolumeAsync(AudioObjectID deviceid, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context) {
+	return SndCtlAsyncSubmit(SndCtlAsyncOperationGetVolume, deviceid, NAN, completionQueue, handler, context);
+}
+
+SndCtlAsyncRequestRef SndCtlGetBalanceAsync(AudioObjectID deviceid, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context) {
+	return SndCtlAsyncSubmit(SndCtlAsyncOperationGetBalance, deviceid, NAN, completionQueue, handler, context);
+}
@@ -0,0 +1,75 @@
+//
+//  SndCtlAsync.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlAsync_h
+#define SndCtlAsync_h
+
+#include <dispatch/dispatch.h>
+#include "SndCtlAudioUtils.h"
+
+/**
+ Asynchronous variants of the \c SndCtlAudioUtils calls.
+
+ Requests are run on a serial queue per device, so they're applied in order without blocking
+ the caller. A set that's still waiting to run is superseded by a newer set of the same property
+ on the same device: only the newest value is written, and the older request completes with
+ \c SndCtlErrorSuperseded\n.
+
+ Each call takes a \c completionQueue to call \c handler on (or \c NULL to call it on the
+ device's work queue), an optional \c handler and a \c context for it, and returns a request
+ that can be cancelled. Release the request with \c SndCtlAsyncRequestRelease()\n.
+ */
+
+/// A queued request.
+typedef struct SndCtlAsyncRequest *SndCtlAsyncRequestRef;
+
+/**
+ Called when a request finishes.
+ @param success	Whether the request was successful.
+ @param value	For gets, the value read. For sets, the value that was requested.
+ @param error	The error on failure. It's released after the handler returns; retain it to keep it.
+ 				Cancelled and superseded requests fail with \c SndCtlErrorCancelled and
+ 				\c SndCtlErrorSuperseded\n.
+ @param context	The context passed when the request was made.
+ */
+typedef void (*SndCtlAsyncCompletionHandler)(bool success, Float64 value, CFErrorRef error, void *context);
+
+/**
+ Cancel a request if it hasn't started yet.
+ @return Whether the request was cancelled. Requests that are already running or finished can't be cancelled.
+ */
+bool SndCtlAsyncRequestCancel(SndCtlAsyncRequestRef request);
+
+/**
+ Release a request returned by one of the asynchronous calls.
+ @discussion Releasing doesn't cancel the request; it just gives up the ability to.
+ */
+void SndCtlAsyncRequestRelease(SndCtlAsyncRequestRef request);
+
+/// Asynchronous \c SndCtlSetVolume()\n.
+SndCtlAsyncRequestRef SndCtlSetVolumeAsync(AudioObjectID deviceid, Float32 volume, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context);
+
+/// Asynchronous \c SndCtlSetBalance()\n.
+SndCtlAsyncRequestRef SndCtlSetBalanceAsync(AudioObjectID deviceid, Float32 balance, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context);
+
+/// Asynchronous \c SndCtlSetNominalSampleRate()\n.
+SndCtlAsyncRequestRef SndCtlSetNominalSampleRateAsync(AudioObjectID deviceid, Float64 sampleRate, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context);
+
+/// Asynchronous \c SndCtlSetBufferFrameSize()\n.
+SndCtlAsyncRequestRef SndCtlSetBufferFrameSizeAsync(AudioObjectID deviceid, UInt32 frames, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context);
+
+/// Asynchronous \c SndCtlSetDefaultOutputDeviceID()\n. \c value is the new default device's ID.
+SndCtlAsyncRequestRef SndCtlSetDefaultOutputDeviceIDAsync(AudioObjectID deviceid, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context);
+
+/// Asynchronous \c SndCtlGetVolume()\n.
+SndCtlAsyncRequestRef SndCtlGetVolumeAsync(AudioObjectID deviceid, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context);
+
+/// Asynchronous \c SndCtlGetBalance()\n.
+SndCtlAsyncRequestRef SndCtlGetBalanceAsync(AudioObjectID deviceid, dispatch_queue_t completionQueue, SndCtlAsyncCompletionHandler handler, void *context);
+
+#endif /* SndCtlAsync_h */
@@ -7,39 +7,16 @@
 //
 
 #include "SndCtlAudioUtils.h"
+#include "SndCtlDeviceTable.h"
+#include "SndCtlError.h"
+#include "SndCtlHAL.h"
+#include <errno.h>
 
 const SndCtlAudioDeviceAttribute kSndCtlAudioDeviceAttributeID = CFSTR("id");
 const SndCtlAudioDeviceAttribute kSndCtlAudioDeviceAttributeName = CFSTR("name");
 const SndCtlAudioDeviceAttribute kSndCtlAudioDeviceAttributeHasMainVolume = CFSTR("hasMainVolume");
 const SndCtlAudioDeviceAttribute kSndCtlAudioDeviceAttributeHasMainBalance = CFSTR("hasMainBalance");
 
-static CFErrorRef SndCtlErrorCreateWithOSStatus(OSStatus status, CFStringRef localizedFailure) {
-	CFStringRef failureReason = NULL;
-
-	switch (status) {
-		case kAudioHardwareBadObjectError:
-		case kAudioHardwareBadDeviceError:
-			failureReason = CFSTR("Device doesn't exist.");
-			break;
-		case kAudioHardwareUnknownPropertyError:
-			failureReason = CFSTR("Device doesn't support the specified property.");
-		default:
-			break;
-	}
-
-	if (failureReason)
-		localizedFailure = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("%@: %@"), localizedFailure, failureReason);
-
-	CFTypeRef keys[] = { kCFErrorLocalizedDescriptionKey, kCFErrorLocalizedFailureReasonKey };
-	CFTypeRef values[] = { localizedFailure, failureReason };
-	CFErrorRef error = CFErrorCreateWithUserInfoKeysAndValues(kCFAllocatorDefault, kCFErrorDomainOSStatus, status, keys, values, failureReason ? 2 : 1);
-
-	if (failureReason)
-		CFRelease(localizedFailure);
-
-	return error;
-}
-
 CFStringRef SndCtlCopyNameOfDeviceID(AudioObjectID deviceid, CFErrorRef *error) {
 	AudioObjectPropertyAddress theAddress = {
 		kAudioObjectPropertyName,
@@ -50,7 +27,7 @@ CFStringRef SndCtlCopyNameOfDeviceID(AudioObjectID deviceid, CFErrorRef *error)
 	CFStringRef name;
 	UInt32 maxlen = sizeof(name);
 
-	OSStatus result = AudioObjectGetPropertyData(deviceid, &theAddress, 0, NULL, &maxlen, &name);
+	OSStatus result = SndCtlHALGetPropertyData(deviceid, &theAddress, 0, NULL, &maxlen, &name);
 
 	if (result != kAudioHardwareNoError) {
 		if (error) {
@@ -75,7 +52,7 @@ UInt32 SndCtlNumberOfChannelsOfDeviceID(AudioObjectID deviceid, CFErrorRef *erro
 	UInt32 propSize;
 	UInt32 numberOfChannels = 0;
 
-	OSStatus result = AudioObjectGetPropertyDataSize(deviceid, &theAddress, 0, NULL, &propSize);
+	OSStatus result = SndCtlHALGetPropertyDataSize(deviceid, &theAddress, 0, NULL, &propSize);
 
 	if (result != kAudioHardwareNoError) {
 		if (error) {
@@ -88,7 +65,7 @@ UInt32 SndCtlNumberOfChannelsOfDeviceID(AudioObjectID deviceid, CFErrorRef *erro
 
 	AudioBufferList *buflist = (AudioBufferList *)malloc(propSize);
 
-	result = AudioObjectGetPropertyData(deviceid, &theAddress, 0, NULL, &propSize, buflist);
+	result = SndCtlHALGetPropertyData(deviceid, &theAddress, 0, NULL, &propSize, buflist);
 
 	if (result == kAudioHardwareNoError) {
 		for (UInt32 i = 0; i < buflist->mNumberBuffers; ++i)
@@ -105,63 +82,49 @@ UInt32 SndCtlNumberOfChannelsOfDeviceID(AudioObjectID deviceid, CFErrorRef *erro
 
 AudioObjectID *SndCtlGetAudioOutputDeviceIDs(CFErrorRef *error) {
 	static AudioObjectID deviceids[64];
-	UInt32 propsize;
-
-	AudioObjectPropertyAddress theAddress = {
-		kAudioHardwarePropertyDevices,
-		kAudioObjectPropertyScopeGlobal,
-		kAudioObjectPropertyElementMaster
-	};
-
-	OSStatus result = AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &theAddress, 0, NULL, &propsize);
-
-	if (result != kAudioHardwareNoError) {
-		if (error)
-			*error = SndCtlErrorCreateWithOSStatus(result, CFSTR("Couldn't copy audio output devices."));
 
-		return NULL;
-	}
+	SndCtlDeviceTable *table = SndCtlDeviceTableCreate(0, error);
 
-	int deviceCount = propsize / sizeof(AudioObjectID);
-	if (deviceCount > 63)
+	if (!table)
 		return NULL;
 
-	AudioObjectID allDevices[deviceCount];
-	result = AudioObjectGetPropertyData(kAudioObjectSystemObject, &theAddress, 0, NULL, &propsize, allDevices);
-
-	if (result != kAudioHardwareNoError) {
+	if (table->count > 63) {
 		if (error)
-			*error = SndCtlErrorCreateWithOSStatus(result, CFSTR("Couldn't copy audio output devices."));
+			*error = SndCtlErrorCreateWithPOSIXCode(ENOBUFS, CFSTR("Couldn't copy audio output devices."));
 
+		SndCtlDeviceTableRelease(table);
 		return NULL;
 	}
 
-	int j = 0;
-	for (int i = 0; i < deviceCount; ++i) {
-		AudioObjectID deviceid = allDevices[i];
-		if (SndCtlNumberOfChannelsOfDeviceID(deviceid, NULL) > 0) {
-			deviceids[j++] = deviceid;
-		}
-	}
+	for (CFIndex i = 0; i < table->count; ++i)
+		deviceids[i] = table->devices[i].deviceid;
 
-	deviceids[j] = kAudioObjectUnknown;
+	deviceids[table->count] = kAudioObjectUnknown;
+
+	SndCtlDeviceTableRelease(table);
 
 	return deviceids;
 }
 
 CFArrayRef SndCtlCopyAudioOutputDevices(CFErrorRef *error) {
-	AudioObjectID *deviceids = SndCtlGetAudioOutputDeviceIDs(error);
+	SndCtlDeviceTable *table = SndCtlDeviceTableCreate(SndCtlDeviceFieldName | SndCtlDeviceFieldHasMainVolume | SndCtlDeviceFieldHasMainBalance, error);
 
-	if (!deviceids)
+	if (!table)
 		return NULL;
 
-	CFMutableArrayRef devices = CFArrayCreateMutable(kCFAllocatorDefault, 0, &kCFTypeArrayCallBacks);
-	AudioObjectID deviceid = kAudioObjectUnknown;
+	CFMutableArrayRef devices = CFArrayCreateMutable(kCFAllocatorDefault, table->count, &kCFTypeArrayCallBacks);
+
+	for (CFIndex i = 0; i < table->count; ++i) {
+		const SndCtlDeviceInfo *info = &table->devices[i];
+		AudioObjectID deviceid = info->deviceid;
 
-	while ( (deviceid = *deviceids++) ) {
-		CFStringRef name = SndCtlCopyNameOfDeviceID(deviceid, NULL);
-		CFBooleanRef hasVolume = SndCtlOutputDeviceHasMainVolume(deviceid) ? kCFBooleanTrue : kCFBooleanFalse;
-		CFBooleanRef hasBalance = SndCtlOutputDeviceHasMainBalance(deviceid) ? kCFBooleanTrue : kCFBooleanFalse;
+		CFStringRef name = info->name ? CFStringCreateWithCString(kCFAllocatorDefault, info->name, kCFStringEncodingUTF8) : NULL;
+
+		if (!name)
+			name = CFRetain(CFSTR(""));
+
+		CFBooleanRef hasVolume = info->hasMainVolume ? kCFBooleanTrue : kCFBooleanFalse;
+		CFBooleanRef hasBalance = info->hasMainBalance ? kCFBooleanTrue : kCFBooleanFalse;
 
 		CFTypeRef keys[] = { kSndCtlAudioDeviceAttributeID, kSndCtlAudioDeviceAttributeName, kSndCtlAudioDeviceAttributeHasMainVolume, kSndCtlAudioDeviceAttributeHasMainBalance };
 		CFNumberRef idNumber = CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &deviceid);
@@ -170,10 +133,13 @@ CFArrayRef SndCtlCopyAudioOutputDevices(CFErrorRef *error) {
 		CFDictionaryRef device = CFDictionaryCreate(kCFAllocatorDefault, keys, values, sizeof(keys) / sizeof(keys[0]), &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
 		CFArrayAppendValue(devices, device);
 
+		CFRelease(device);
 		CFRelease(idNumber);
 		CFRelease(name);
 	}
 
+	SndCtlDeviceTableRelease(table);
+
 	return devices;
 }
 
@@ -186,7 +152,7 @@ AudioObjectID SndCtlDefaultOutputDeviceID(CFErrorRef *error) {
 
 	AudioObjectID defaultOutputDeviceID;
 	UInt32 deviceIDSize = sizeof(defaultOutputDeviceID);
-	OSStatus result = AudioObjectGetPropertyData(kAudioObjectSystemObject, &defaultOutputDevicePropertyAddress, 0, NULL, &deviceIDSize, &defaultOutputDeviceID);
+	OSStatus result = SndCtlHALGetPropertyData(kAudioObjectSystemObject, &defaultOutputDevicePropertyAddress, 0, NULL, &deviceIDSize, &defaultOutputDeviceID);
 
 	if (result != kAudioHardwareNoError) {
 		if (error) {
@@ -206,7 +172,7 @@ bool SndCtlSetDefaultOutputDeviceID(AudioObjectID deviceid, CFErrorRef *error) {
 	};
 
 	UInt32 deviceIDSize = sizeof(deviceid);
-	OSStatus result = AudioObjectSetPropertyData(kAudioObjectSystemObject, &defaultOutputDevicePropertyAddress, 0, NULL, deviceIDSize, &deviceid);
+	OSStatus result = SndCtlHALSetPropertyData(kAudioObjectSystemObject, &defaultOutputDevicePropertyAddress, 0, NULL, deviceIDSize, &deviceid);
 
 	if (result != kAudioHardwareNoError) {
 		if (error) {
@@ -219,15 +185,6 @@ bool SndCtlSetDefaultOutputDeviceID(AudioObjectID deviceid, CFErrorRef *error) {
 	return true;
 }
 
-char *SndCtlNameForDeviceProperty(AudioObjectPropertySelector selector) {
-	if (selector == kAudioHardwareServiceDeviceProperty_VirtualMainBalance)
-		return "balance";
-	else if (selector == kAudioHardwareServiceDeviceProperty_VirtualMainBalance)
-		return "volume";
-
-	return NULL;
-}
-
 static bool SndCtlOutputDeviceHasProperty(AudioObjectID deviceid, AudioObjectPropertySelector selector) {
 	if (deviceid == kAudioDeviceUnknown)
 		deviceid = SndCtlDefaultOutputDeviceID(NULL);
@@ -240,7 +197,7 @@ static bool SndCtlOutputDeviceHasProperty(AudioObjectID deviceid, AudioObjectPro
 		kAudioObjectPropertyElementMaster
 	};
 
-	return AudioObjectHasProperty(deviceid, &propertyAddress);
+	return SndCtlHALHasProperty(deviceid, &propertyAddress);
 }
 
 static Float32 SndCtlGetOutputDeviceFloatProperty(AudioObjectID deviceid, AudioObjectPropertySelector selector, CFErrorRef *error) {
@@ -257,7 +214,7 @@ static Float32 SndCtlGetOutputDeviceFloatProperty(AudioObjectID deviceid, AudioO
 
 	Float32 value;
 	UInt32 size = sizeof(value);
-	OSStatus result = AudioObjectGetPropertyData(deviceid, &propertyAddress, 0, NULL, &size, &value);
+	OSStatus result = SndCtlHALGetPropertyData(deviceid, &propertyAddress, 0, NULL, &size, &value);
 
 	if (result != kAudioHardwareNoError) {
 		if (error) {
@@ -265,6 +222,8 @@ static Float32 SndCtlGetOutputDeviceFloatProperty(AudioObjectID deviceid, AudioO
 			*error = SndCtlErrorCreateWithOSStatus(result, localizedDescription);
 			CFRelease(localizedDescription);
 		}
+
+		return NAN;
 	}
 
 	if (size != sizeof(value))
@@ -286,7 +245,7 @@ static bool SndCtlSetOutputDeviceFloatProperty(AudioObjectID deviceid, AudioObje
 		kAudioObjectPropertyElementMaster
 	};
 
-	OSStatus result = AudioObjectSetPropertyData(deviceid, &propertyAddress, 0, NULL, sizeof(value), &value);
+	OSStatus result = SndCtlHALSetPropertyData(deviceid, &propertyAddress, 0, NULL, sizeof(value), &value);
 
 	if (result != kAudioHardwareNoError) {
 		if (error) {
@@ -296,7 +255,7 @@ static bool SndCtlSetOutputDeviceFloatProperty(AudioObjectID deviceid, AudioObje
 		}
 	}
 
-	return result;
+	return result == kAudioHardwareNoError;
 }
 
 
@@ -342,6 +301,193 @@ bool SndCtlIncrementVolume(AudioObjectID deviceid, Float32 delta, CFErrorRef *er
 	return false;
 }
 
+static AudioObjectID SndCtlResolveOutputDeviceID(AudioObjectID deviceid, CFErrorRef *error) {
+	if (deviceid == kAudioDeviceUnknown)
+		deviceid = SndCtlDefaultOutputDeviceID(error);
+
+	return deviceid;
+}
+
+static bool SndCtlGetDeviceProperty(AudioObjectID deviceid, AudioObjectPropertySelector selector, AudioObjectPropertyScope scope, void *value, UInt32 size, const char *description, CFErrorRef *error) {
+	AudioObjectPropertyAddress propertyAddress = {
+		selector,
+		scope,
+		kAudioObjectPropertyElementMaster
+	};
+
+	UInt32 propSize = size;
+	OSStatus result = SndCtlHALGetPropertyData(deviceid, &propertyAddress, 0, NULL, &propSize, value);
+
+	if (result == kAudioHardwareNoError && propSize != size)
+		result = kAudioHardwareBadPropertySizeError;
+
+	if (result != kAudioHardwareNoError) {
+		if (error) {
+			CFStringRef localizedDescription = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("Couldn't get %s for device ID %u"), description, deviceid);
+			*error = SndCtlErrorCreateWithOSStatus(result, localizedDescription);
+			CFRelease(localizedDescription);
+		}
+
+		return false;
+	}
+
+	return true;
+}
+
+static bool SndCtlSetDeviceProperty(AudioObjectID deviceid, AudioObjectPropertySelector selector, const void *value, UInt32 size, const char *description, CFErrorRef *error) {
+	AudioObjectPropertyAddress propertyAddress = {
+		selector,
+		kAudioObjectPropertyScopeGlobal,
+		kAudioObjectPropertyElementMaster
+	};
+
+	OSStatus result = SndCtlHALSetPropertyData(deviceid, &propertyAddress, 0, NULL, size, value);
+
+	if (result != kAudioHardwareNoError) {
+		if (error) {
+			CFStringRef localizedDescription = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("Couldn't set %s for device ID %u"), description, deviceid);
+			*error = SndCtlErrorCreateWithOSStatus(result, localizedDescription);
+			CFRelease(localizedDescription);
+		}
+
+		return false;
+	}
+
+	return true;
+}
+
+Float64 SndCtlGetNominalSampleRate(AudioObjectID deviceid, CFErrorRef *error) {
+	deviceid = SndCtlResolveOutputDeviceID(deviceid, error);
+	if (deviceid == kAudioDeviceUnknown)
+		return NAN;
+
+	Float64 sampleRate;
+
+	if (!SndCtlGetDeviceProperty(deviceid, kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, &sampleRate, sizeof(sampleRate), "sample rate", error))
+		return NAN;
+
+	return sampleRate;
+}
+
+bool SndCtlSetNominalSampleRate(AudioObjectID deviceid, Float64 sampleRate, CFErrorRef *error) {
+	deviceid = SndCtlResolveOutputDeviceID(deviceid, error);
+	if (deviceid == kAudioDeviceUnknown)
+		return false;
+
+	AudioObjectPropertyAddress propertyAddress = {
+		kAudioDevicePropertyAvailableNominalSampleRates,
+		kAudioObjectPropertyScopeGlobal,
+		kAudioObjectPropertyElementMaster
+	};
+
+	UInt32 size;
+	OSStatus result = SndCtlHALGetPropertyDataSize(deviceid, &propertyAddress, 0, NULL, &size);
+	bool supported = false;
+
+	if (result == kAudioHardwareNoError) {
+		UInt32 count = size / sizeof(AudioValueRange);
+		AudioValueRange ranges[count > 0 ? count : 1];
+		result = SndCtlHALGetPropertyData(deviceid, &propertyAddress, 0, NULL, &size, ranges);
+		count = size / sizeof(AudioValueRange);
+
+		for (UInt32 i = 0; result == kAudioHardwareNoError && i < count; ++i) {
+			if (sampleRate >= ranges[i].mMinimum && sampleRate <= ranges[i].mMaximum)
+				supported = true;
+		}
+	}
+
+	if (result != kAudioHardwareNoError) {
+		if (error) {
+			CFStringRef localizedDescription = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("Couldn't get available sample rates for device ID %u"), deviceid);
+			*error = SndCtlErrorCreateWithOSStatus(result, localizedDescription);
+			CFRelease(localizedDescription);
+		}
+
+		return false;
+	}
+
+	if (!supported) {
+		if (error) {
+			CFStringRef localizedDescription = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("Device ID %u doesn't support a sample rate of %g Hz."), deviceid, sampleRate);
+			*error = SndCtlErrorCreate(SndCtlErrorValueOutOfRange, localizedDescription);
+			CFRelease(localizedDescription);
+		}
+
+		return false;
+	}
+
+	return SndCtlSetDeviceProperty(deviceid, kAudioDevicePropertyNominalSampleRate, &sampleRate, sizeof(sampleRate), "sample rate", error);
+}
+
+UInt32 SndCtlGetBufferFrameSize(AudioObjectID deviceid, CFErrorRef *error) {
+	deviceid = SndCtlResolveOutputDeviceID(deviceid, error);
+	if (deviceid == kAudioDeviceUnknown)
+		return 0;
+
+	UInt32 frames;
+
+	if (!SndCtlGetDeviceProperty(deviceid, kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal, &frames, sizeof(frames), "buffer size", error))
+		return 0;
+
+	return frames;
+}
+
+bool SndCtlSetBufferFrameSize(AudioObjectID deviceid, UInt32 frames, CFErrorRef *error) {
+	deviceid = SndCtlResolveOutputDeviceID(deviceid, error);
+	if (deviceid == kAudioDeviceUnknown)
+		return false;
+
+	AudioValueRange range;
+
+	if (!SndCtlGetDeviceProperty(deviceid, kAudioDevicePropertyBufferFrameSizeRange, kAudioObjectPropertyScopeGlobal, &range, sizeof(range), "buffer size range", error))
+		return false;
+
+	if (frames < range.mMinimum || frames > range.mMaximum) {
+		if (error) {
+			CFStringRef localizedDescription = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("Buffer size must be between %g and %g frames for device ID %u."), range.mMinimum, range.mMaximum, deviceid);
+			*error = SndCtlErrorCreate(SndCtlErrorValueOutOfRange, localizedDescription);
+			CFRelease(localizedDescription);
+		}
+
+		return false;
+	}
+
+	return SndCtlSetDeviceProperty(deviceid, kAudioDevicePropertyBufferFrameSize, &frames, sizeof(frames), "buffer size", error);
+}
+
+bool SndCtlGetOutputLatency(AudioObjectID deviceid, SndCtlOutputLatency *latency, CFErrorRef *error) {
+	deviceid = SndCtlResolveOutputDeviceID(deviceid, error);
+	if (deviceid == kAudioDeviceUnknown)
+		return false;
+
+	*latency = (SndCtlOutputLatency){ 0 };
+
+	if (!SndCtlGetDeviceProperty(deviceid, kAudioDevicePropertyLatency, kAudioObjectPropertyScopeOutput, &latency->deviceFrames, sizeof(latency->deviceFrames), "latency", error)
+		|| !SndCtlGetDeviceProperty(deviceid, kAudioDevicePropertySafetyOffset, kAudioObjectPropertyScopeOutput, &latency->safetyOffsetFrames, sizeof(latency->safetyOffsetFrames), "safety offset", error)
+		|| !SndCtlGetDeviceProperty(deviceid, kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal, &latency->bufferFrames, sizeof(latency->bufferFrames), "buffer size", error)
+		|| !SndCtlGetDeviceProperty(deviceid, kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, &latency->sampleRate, sizeof(latency->sampleRate), "sample rate", error))
+		return false;
+
+	// Streams are optional; a device without one just has no stream latency.
+	AudioObjectPropertyAddress streamsAddress = {
+		kAudioDevicePropertyStreams,
+		kAudioObjectPropertyScopeOutput,
+		kAudioObjectPropertyElementMaster
+	};
+
+	AudioStreamID streamid;
+	UInt32 size = sizeof(streamid);
+
+	if (SndCtlHALGetPropertyData(deviceid, &streamsAddress, 0, NULL, &size, &streamid) == kAudioHardwareNoError && size == sizeof(streamid))
+		SndCtlGetDeviceProperty(streamid, kAudioStreamPropertyLatency, kAudioObjectPropertyScopeGlobal, &latency->streamFrames, sizeof(latency->streamFrames), "stream latency", NULL);
+
+	return true;
+}
+
+UInt32 SndCtlOutputLatencyTotalFrames(const SndCtlOutputLatency *latency) {
+	return latency->deviceFrames + latency->streamFrames + latency->safetyOffsetFrames + latency->bufferFrames;
+}
+
 CFArrayRef SndCtlCopyAudioDevicesMatchingString(const char *stringToMatch, CFErrorRef *error) {
 	CFArrayRef devices = SndCtlCopyAudioOutputDevices(error);
 
@@ -61,6 +61,8 @@ UInt32 SndCtlNumberOfChannelsOfDeviceID(AudioObjectID deviceid, CFErrorRef *erro
  Get the IDs of available output devices.
  @param error	An error set on failure.
  @return	A list of \c AudioObjectID\n, terminated by \c kAudioObjectUnknown, or \c NULL on failure.
+ @discussion The list is ordered by ID and is overwritten by the next call. Built from
+ 	\c SndCtlDeviceTableCreate()\n, so devices are checked concurrently.
  */
 
 AudioObjectID *SndCtlGetAudioOutputDeviceIDs(CFErrorRef *error);
@@ -71,10 +73,20 @@ AudioObjectID *SndCtlGetAudioOutputDeviceIDs(CFErrorRef *error);
  @return An array of dictionaries represending the valid audio devices. Returns \c NULL
  	and sets \c error on failure.
  @discussion Valid returned audio devices currently include 2-channel devices.
- 	See \c SndCtlAudioDeviceAttribute for valid keys.
+ 	See \c SndCtlAudioDeviceAttribute for valid keys. Built from \c SndCtlDeviceTableCreate()\n,
+ 	so devices are fetched concurrently and ordered by ID.
  */
 CFArrayRef SndCtlCopyAudioOutputDevices(CFErrorRef *error);
 
+/**
+ Gets the default audio output device.
+ @param	error	An error on failure.
+ @return		The ID of the default output device, or \c kAudioDeviceUnknown on failure.
+ @discussion Functions that take a device ID look this up themselves when passed \c 0\n;
+ 	callers making several calls on the default device can look it up once instead.
+ */
+AudioObjectID SndCtlDefaultOutputDeviceID(CFErrorRef *error);
+
 /**
  Sets the default audio output device.
  @param	deviceid	The ID of the output device to set as the default.
@@ -145,6 +157,65 @@ bool SndCtlIncrementVolume(AudioObjectID deviceid, Float32 delta, CFErrorRef *er
  */
 bool SndCtlIncrementBalance(AudioObjectID deviceid, Float32 delta, CFErrorRef *error);
 
+/**
+ Gets the nominal sample rate of a device.
+ @param	deviceid	The ID of the device.
+ @param	error		An error on failure.
+ @return			The sample rate in Hz, or \c NAN on failure.
+ */
+Float64 SndCtlGetNominalSampleRate(AudioObjectID deviceid, CFErrorRef *error);
+
+/**
+ Sets the nominal sample rate of a device.
+ @param	deviceid	The ID of the device.
+ @param	sampleRate	The sample rate in Hz. Must be one of the device's available rates.
+ @param	error		An error on failure.
+ @return			Whether setting the sample rate was successful.
+ */
+bool SndCtlSetNominalSampleRate(AudioObjectID deviceid, Float64 sampleRate, CFErrorRef *error);
+
+/**
+ Gets the I/O buffer size of a device.
+ @param	deviceid	The ID of the device.
+ @param	error		An error on failure.
+ @return			The buffer size in frames, or \c 0 on failure.
+ */
+UInt32 SndCtlGetBufferFrameSize(AudioObjectID deviceid, CFErrorRef *error);
+
+/**
+ Sets the I/O buffer size of a device.
+ @param	deviceid	The ID of the device.
+ @param	frames		The buffer size in frames. Must be within the device's allowed range.
+ @param	error		An error on failure.
+ @return			Whether setting the buffer size was successful.
+ */
+bool SndCtlSetBufferFrameSize(AudioObjectID deviceid, UInt32 frames, CFErrorRef *error);
+
+/// The components of a device's output latency, in frames.
+typedef struct {
+	UInt32 deviceFrames;
+	UInt32 streamFrames;
+	UInt32 safetyOffsetFrames;
+	UInt32 bufferFrames;
+	/// The nominal sample rate, for converting to time.
+	Float64 sampleRate;
+} SndCtlOutputLatency;
+
+/**
+ Gets the output latency of a device.
+ @param	deviceid	The ID of the device.
+ @param	latency		Set to the latency components on success.
+ @param	error		An error on failure.
+ @return			Whether the latency could be determined.
+ @discussion The stream latency is that of the device's first output stream.
+ */
+bool SndCtlGetOutputLatency(AudioObjectID deviceid, SndCtlOutputLatency *latency, CFErrorRef *error);
+
+/**
+ Returns the total of a latency's components, in frames.
+ */
+UInt32 SndCtlOutputLatencyTotalFrames(const SndCtlOutputLatency *latency);
+
 /**
  Returns an array of audio devices whose name matches a string.
  @param		stringToMatch	The string to match, case-insensitively.
@@ -0,0 +1,484 @@
+//
+//  SndCtlControlServer.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlControlServer.h"
+#include "SndCtlAudioUtils.h"
+#include "SndCtlError.h"
+#include <dispatch/dispatch.h>
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+typedef enum {
+	SndCtlControlPropertyVolume,
+	SndCtlControlPropertyBalance,
+	SndCtlControlPropertyDefault,
+} SndCtlControlProperty;
+
+typedef struct {
+	/// \c kAudioObjectUnknown for the default output device.
+	AudioObjectID deviceid;
+	SndCtlControlProperty property;
+	Float32 value;
+} SndCtlControlMessage;
+
+// Must be a power of two. At 1 kHz this is four seconds of backlog.
+#define kSndCtlControlQueueCapacity 4096
+
+// The most distinct device/property pairs coalesced per round; more just means an extra round.
+#define kSndCtlControlMaxPendingWrites 64
+
+// How often the receiving thread checks whether it's been stopped.
+static const int kSndCtlControlReceiveTimeoutMsec = 100;
+
+/**
+ A single-producer, single-consumer ring. The receiving thread only writes \c tail and the writer
+ thread only writes \c head\n; each reads the other's index with acquire semantics, so a slot is
+ never read before it's filled or overwritten before it's consumed.
+
+ \c tail is published sequentially consistently so that it's ordered against the writer's
+ \c writerSleeping flag: either the writer sees the new message when it checks the queue after
+ setting the flag, or the receiving thread sees the flag and wakes it.
+ */
+typedef struct {
+	SndCtlControlMessage messages[kSndCtlControlQueueCapacity];
+	UInt32 head;
+	UInt32 tail;
+} SndCtlControlQueue;
+
+struct SndCtlControlServer {
+	int socket;
+	/// Set from any thread or a signal handler.
+	int stopping;
+
+	SndCtlControlQueue queue;
+	/// Signalled when a message is pushed while the writer is sleeping, and on shutdown.
+	dispatch_semaphore_t queueSignal;
+	/// Set by the writer just before it waits on \c queueSignal\n, cleared by whoever wakes it.
+	bool writerSleeping;
+	bool writerShouldExit;
+
+	SndCtlControlServerStatistics statistics;
+};
+
+static bool SndCtlControlQueuePush(SndCtlControlQueue *queue, const SndCtlControlMessage *message) {
+	UInt32 tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+	UInt32 head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+	if (tail - head == kSndCtlControlQueueCapacity)
+		return false;
+
+	queue->messages[tail & (kSndCtlControlQueueCapacity - 1)] = *message;
+	__atomic_store_n(&queue->tail, tail + 1, __ATOMIC_SEQ_CST);
+
+	return true;
+}
+
+static bool SndCtlControlQueueIsEmpty(SndCtlControlQueue *queue) {
+	return __atomic_load_n(&queue->head, __ATOMIC_RELAXED) == __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST);
+}
+
+static bool SndCtlControlQueuePop(SndCtlControlQueue *queue, SndCtlControlMessage *message) {
+	UInt32 head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+	UInt32 tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+	if (head == tail)
+		return false;
+
+	*message = queue->messages[head & (kSndCtlControlQueueCapacity - 1)];
+	__atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+static void SndCtlControlCount(UInt64 *counter) {
+	__atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+typedef struct {
+	SndCtlControlMessage messages[kSndCtlControlMaxPendingWrites];
+	size_t count;
+} SndCtlControlPendingWrites;
+
+// Replaces any pending write to the same device and property. Returns false if there's no room.
+static bool SndCtlControlPendingWritesAdd(SndCtlControlPendingWrites *pending, const SndCtlControlMessage *message) {
+	for (size_t i = 0; i < pending->count; ++i) {
+		SndCtlControlMessage *existing = &pending->messages[i];
+
+		// There's only one default device, so default changes all coalesce together.
+		bool sameTarget = message->property == SndCtlControlPropertyDefault || existing->deviceid == message->deviceid;
+
+		if (existing->property == message->property && sameTarget) {
+			*existing = *message;
+			return true;
+		}
+	}
+
+	if (pending->count == kSndCtlControlMaxPendingWrites)
+		return false;
+
+	pending->messages[pending->count++] = *message;
+	return true;
+}
+
+static void SndCtlControlServerWrite(SndCtlControlServerRef server, SndCtlControlPendingWrites *pending) {
+	AudioObjectID defaultDeviceID = kAudioObjectUnknown;
+
+	// Change the default first, so the rest of the round sees the new one.
+	for (size_t i = 0; i < pending->count; ++i) {
+		SndCtlControlMessage *message = &pending->messages[i];
+
+		if (message->property != SndCtlControlPropertyDefault)
+			continue;
+
+		AudioObjectID deviceid = message->deviceid;
+
+		if (deviceid == kAudioObjectUnknown)
+			deviceid = SndCtlDefaultOutputDeviceID(NULL);
+
+		SndCtlControlCount(&server->statistics.writes);
+
+		if (deviceid != kAudioObjectUnknown && SndCtlSetDefaultOutputDeviceID(deviceid, NULL))
+			defaultDeviceID = deviceid;
+		else
+			SndCtlControlCount(&server->statistics.writesFailed);
+	}
+
+	for (size_t i = 0; i < pending->count; ++i) {
+		SndCtlControlMessage *message = &pending->messages[i];
+
+		if (message->property == SndCtlControlPropertyDefault)
+			continue;
+
+		AudioObjectID deviceid = message->deviceid;
+
+		// Looked up at most once per round.
+		if (deviceid == kAudioObjectUnknown) {
+			if (defaultDeviceID == kAudioObjectUnknown)
+				defaultDeviceID = SndCtlDefaultOutputDeviceID(NULL);
+
+			deviceid = defaultDeviceID;
+		}
+
+		bool success = false;
+
+		if (deviceid != kAudioObjectUnknown) {
+			if (message->property == SndCtlControlPropertyVolume)
+				success = SndCtlSetVolume(deviceid, message->value, NULL);
+			else
+				success = SndCtlSetBalance(deviceid, message->value, NULL);
+		}
+
+		SndCtlControlCount(&server->statistics.writes);
+
+		if (!success)
+			SndCtlControlCount(&server->statistics.writesFailed);
+	}
+
+	pending->count = 0;
+}
+
+static void *SndCtlControlServerWriterThread(void *context) {
+	SndCtlControlServerRef server = context;
+	SndCtlControlPendingWrites pending = { .count = 0 };
+
+	while (true) {
+		// Writes take a while, so keep going until a whole round finds nothing new.
+		while (true) {
+			SndCtlControlMessage message;
+
+			while (SndCtlControlQueuePop(&server->queue, &message)) {
+				if (!SndCtlControlPendingWritesAdd(&pending, &message)) {
+					SndCtlControlServerWrite(server, &pending);
+					SndCtlControlPendingWritesAdd(&pending, &message);
+				}
+			}
+
+			if (pending.count == 0)
+				break;
+
+			SndCtlControlServerWrite(server, &pending);
+		}
+
+		if (__atomic_load_n(&server->writerShouldExit, __ATOMIC_ACQUIRE))
+			break;
+
+		// A message pushed before the flag was visible didn't signal, so check once more after
+		// setting it. A wake-up that races with finding the queue non-empty just costs an extra
+		// empty round.
+		__atomic_store_n(&server->writerSleeping, true, __ATOMIC_SEQ_CST);
+
+		if (SndCtlControlQueueIsEmpty(&server->queue))
+			dispatch_semaphore_wait(server->queueSignal, DISPATCH_TIME_FOREVER);
+
+		__atomic_store_n(&server->writerSleeping, false, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+// Reads a padded OSC string, returning it and advancing past its padding, or NULL if it's malformed.
+static const char *SndCtlOSCReadString(const UInt8 **cursor, const UInt8 *end) {
+	const char *string = (const char *)*cursor;
+	const UInt8 *terminator = memchr(*cursor, '\0', end - *cursor);
+
+	if (!terminator)
+		return NULL;
+
+	size_t paddedLength = ((terminator - *cursor) / 4 + 1) * 4;
+
+	if (paddedLength > (size_t)(end - *cursor))
+		return NULL;
+
+	*cursor += paddedLength;
+	return string;
+}
+
+static UInt32 SndCtlOSCReadUInt32(const UInt8 *bytes) {
+	return (UInt32)bytes[0] << 24 | (UInt32)bytes[1] << 16 | (UInt32)bytes[2] << 8 | bytes[3];
+}
+
+// Reads the first argument as a float, if it's a type that converts to one.
+static bool SndCtlOSCReadFloatArgument(const char *typeTags, const UInt8 *arguments, const UInt8 *end, Float32 *value) {
+	switch (typeTags[1]) {
+		case 'f': {
+			if (end - arguments < 4)
+				return false;
+
+			UInt32 bits = SndCtlOSCReadUInt32(arguments);
+			memcpy(value, &bits, sizeof(*value));
+			return true;
+		}
+		case 'd': {
+			if (end - arguments < 8)
+				return false;
+
+			UInt64 bits = (UInt64)SndCtlOSCReadUInt32(arguments) << 32 | SndCtlOSCReadUInt32(arguments + 4);
+			Float64 doubleValue;
+			memcpy(&doubleValue, &bits, sizeof(doubleValue));
+			*value = (Float32)doubleValue;
+			return true;
+		}
+		case 'i':
+			if (end - arguments < 4)
+				return false;
+
+			*value = (Float32)(SInt32)SndCtlOSCReadUInt32(arguments);
+			return true;
+		default:
+			return false;
+	}
+}
+
+// Parses "/sndctl/<device>/<property>".
+static bool SndCtlOSCParseAddress(const char *address, SndCtlControlMessage *message) {
+	static const char prefix[] = "/sndctl/";
+
+	if (strncmp(address, prefix, sizeof(prefix) - 1) != 0)
+		return false;
+
+	const char *device = address + sizeof(prefix) - 1;
+	const char *property = strchr(device, '/');
+
+	if (!property)
+		return false;
+
+	size_t deviceLength = property - device;
+	++property;
+
+	if (deviceLength == strlen("default") && strncmp(device, "default", deviceLength) == 0)
+		message->deviceid = kAudioObjectUnknown;
+	else {
+		char *endptr;
+		message->deviceid = (AudioObjectID)strtoul(device, &endptr, 10);
+
+		if (endptr != device + deviceLength || message->deviceid == kAudioObjectUnknown)
+			return false;
+	}
+
+	if (strcmp(property, "volume") == 0)
+		message->property = SndCtlControlPropertyVolume;
+	else if (strcmp(property, "balance") == 0)
+		message->property = SndCtlControlPropertyBalance;
+	else if (strcmp(property, "default") == 0)
+		message->property = SndCtlControlPropertyDefault;
+	else
+		return false;
+
+	return true;
+}
+
+static void SndCtlControlServerEnqueue(SndCtlControlServerRef server, const SndCtlControlMessage *message) {
+	if (!SndCtlControlQueuePush(&server->queue, message)) {
+		SndCtlControlCount(&server->statistics.messagesDropped);
+		return;
+	}
+
+	SndCtlControlCount(&server->statistics.messagesReceived);
+
+	// An awake writer drains the queue until it's empty before it sleeps again.
+	if (__atomic_exchange_n(&server->writerSleeping, false, __ATOMIC_SEQ_CST))
+		dispatch_semaphore_signal(server->queueSignal);
+}
+
+static void SndCtlControlServerHandleMessage(SndCtlControlServerRef server, const UInt8 *bytes, const UInt8 *end) {
+	const UInt8 *cursor = bytes;
+	const char *address = SndCtlOSCReadString(&cursor, end);
+	SndCtlControlMessage message = { .value = 0.0 };
+
+	if (!address || !SndCtlOSCParseAddress(address, &message)) {
+		SndCtlControlCount(&server->statistics.messagesIgnored);
+		return;
+	}
+
+	// Type tags are optional in old senders; a message without them has no arguments.
+	const char *typeTags = cursor < end && *cursor == ',' ? SndCtlOSCReadString(&cursor, end) : ",";
+
+	if (!typeTags || (message.property != SndCtlControlPropertyDefault && !SndCtlOSCReadFloatArgument(typeTags, cursor, end, &message.value))) {
+		SndCtlControlCount(&server->statistics.messagesIgnored);
+		return;
+	}
+
+	// Also catches NaN, which fails both comparisons.
+	if (message.property != SndCtlControlPropertyDefault && !(message.value >= 0.0 && message.value <= 1.0)) {
+		SndCtlControlCount(&server->statistics.messagesRejected);
+		return;
+	}
+
+	SndCtlControlServerEnqueue(server, &message);
+}
+
+static void SndCtlControlServerHandlePacket(SndCtlControlServerRef server, const UInt8 *bytes, const UInt8 *end, unsigned depth) {
+	static const char bundleTag[] = "#bundle";
+
+	if ((size_t)(end - bytes) < sizeof(bundleTag) || memcmp(bytes, bundleTag, sizeof(bundleTag)) != 0) {
+		SndCtlControlServerHandleMessage(server, bytes, end);
+		return;
+	}
+
+	// Bundles are applied immediately regardless of their time tag. The depth limit keeps a
+	// hostile packet from recursing forever.
+	if (depth > 8 || end - bytes < 16) {
+		SndCtlControlCount(&server->statistics.messagesIgnored);
+		return;
+	}
+
+	const UInt8 *cursor = bytes + 16;
+
+	while (end - cursor >= 4) {
+		UInt32 size = SndCtlOSCReadUInt32(cursor);
+		cursor += 4;
+
+		if (size > (size_t)(end - cursor) || size % 4 != 0) {
+			SndCtlControlCount(&server->statistics.messagesIgnored);
+			return;
+		}
+
+		SndCtlControlServerHandlePacket(server, cursor, cursor + size, depth + 1);
+		cursor += size;
+	}
+}
+
+SndCtlControlServerRef SndCtlControlServerCreate(UInt16 port, CFErrorRef *error) {
+	int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	if (sock < 0) {
+		if (error)
+			*error = SndCtlErrorCreateWithPOSIXCode(errno, CFSTR("Couldn't create the control socket."));
+
+		return NULL;
+	}
+
+	struct sockaddr_in address = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+
+	struct timeval timeout = { 0, kSndCtlControlReceiveTimeoutMsec * 1000 };
+
+	if (bind(sock, (struct sockaddr *)&address, sizeof(address)) != 0 || setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0) {
+		if (error) {
+			CFStringRef description = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("Couldn't listen on port %u."), port);
+			*error = SndCtlErrorCreateWithPOSIXCode(errno, description);
+			CFRelease(description);
+		}
+
+		close(sock);
+		return NULL;
+	}
+
+	SndCtlControlServerRef server = calloc(1, sizeof(struct SndCtlControlServer));
+	server->socket = sock;
+	server->queueSignal = dispatch_semaphore_create(0);
+
+	return server;
+}
+
+void SndCtlControlServerRun(SndCtlControlServerRef server) {
+	// Signals should interrupt the receiving thread, not the writer.
+	sigset_t allSignals, previousSignals;
+	sigfillset(&allSignals);
+	pthread_sigmask(SIG_BLOCK, &allSignals, &previousSignals);
+
+	pthread_t writer;
+	bool hasWriter = pthread_create(&writer, NULL, SndCtlControlServerWriterThread, server) == 0;
+
+	pthread_sigmask(SIG_SETMASK, &previousSignals, NULL);
+
+	// The largest possible UDP payload.
+	UInt8 *packet = malloc(65535);
+
+	while (hasWriter && !__atomic_load_n(&server->stopping, __ATOMIC_RELAXED)) {
+		ssize_t length = recv(server->socket, packet, 65535, 0);
+
+		// Timeouts and interruptions just mean it's time to check for a stop.
+		if (length < 0)
+			continue;
+
+		SndCtlControlServerHandlePacket(server, packet, packet + length, 0);
+	}
+
+	free(packet);
+
+	if (hasWriter) {
+		__atomic_store_n(&server->writerShouldExit, true, __ATOMIC_RELEASE);
+		dispatch_semaphore_signal(server->queueSignal);
+		pthread_join(writer, NULL);
+	}
+}
+
+void SndCtlControlServerStop(SndCtlControlServerRef server) {
+	__atomic_store_n(&server->stopping, 1, __ATOMIC_RELAXED);
+}
+
+SndCtlControlServerStatistics SndCtlControlServerGetStatistics(SndCtlControlServerRef server) {
+	SndCtlControlServerStatistics statistics = {
+		.messagesReceived = __atomic_load_n(&server->statistics.messagesReceived, __ATOMIC_RELAXED),
+		.messagesIgnored = __atomic_load_n(&server->statistics.messagesIgnored, __ATOMIC_RELAXED),
+		.messagesRejected = __atomic_load_n(&server->statistics.messagesRejected, __ATOMIC_RELAXED),
+		.messagesDropped = __atomic_load_n(&server->statistics.messagesDropped, __ATOMIC_RELAXED),
+		.writes = __atomic_load_n(&server->statistics.writes, __ATOMIC_RELAXED),
+		.writesFailed = __atomic_load_n(&server->statistics.writesFailed, __ATOMIC_RELAXED),
+	};
+
+	return statistics;
+}
+
+void SndCtlControlServerRelease(SndCtlControlServerRef server) {
+	if (!server)
+		return;
+
+	close(server->socket);
+	dispatch_release(server->queueSignal);
+	free(server);
+}
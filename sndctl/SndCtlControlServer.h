@@ -0,0 +1,84 @@
+//
+//  SndCtlControlServer.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlControlServer_h
+#define SndCtlControlServer_h
+
+#include <stdio.h>
+#include <AudioToolbox/AudioToolbox.h>
+
+/**
+ A local OSC server for driving sndctl from controllers and show-control software.
+
+ The server listens for OSC 1.0 messages (bare or in bundles) on a UDP port on the loopback
+ interface:
+
+ 	/sndctl/<device>/volume f		Set the volume, from 0.0 to 1.0.
+ 	/sndctl/<device>/balance f		Set the balance, from 0.0 (left) to 1.0 (right).
+ 	/sndctl/<device>/default		Make the device the default output device.
+
+ where \c <device> is a device ID or \c default for the current default output device. Volume
+ and balance also accept \c d and \c i arguments. Values that are out of range, infinite or NaN
+ are rejected rather than passed on to the HAL.
+
+ Messages are parsed on the receiving thread and passed through a lock-free queue to a separate
+ thread that does the HAL writes. Before each round of writes, everything that's queued is
+ coalesced to the latest value per device and property, so a fader sending updates faster than
+ the HAL can take them costs one write per round rather than one per message.
+ */
+typedef struct SndCtlControlServer *SndCtlControlServerRef;
+
+/// Counters for a server's lifetime.
+typedef struct {
+	/// Well-formed messages for a known address.
+	UInt64 messagesReceived;
+	/// Packets or messages that couldn't be parsed or had an unknown address.
+	UInt64 messagesIgnored;
+	/// Volume or balance messages whose value wasn't a number from 0.0 to 1.0.
+	UInt64 messagesRejected;
+	/// Messages dropped because the queue to the writer was full.
+	UInt64 messagesDropped;
+	/// HAL writes made. Each round of writes makes at most one per device and property.
+	UInt64 writes;
+	/// HAL writes that failed.
+	UInt64 writesFailed;
+} SndCtlControlServerStatistics;
+
+/**
+ Create a server listening on a loopback UDP port.
+ @param port	The port to listen on.
+ @param error	An error on failure.
+ @return A new server, or \c NULL if the socket couldn't be set up. Free it with
+ 	\c SndCtlControlServerRelease()\n.
+ */
+SndCtlControlServerRef SndCtlControlServerCreate(UInt16 port, CFErrorRef *error);
+
+/**
+ Serve requests until \c SndCtlControlServerStop() is called.
+ @discussion Receives on the calling thread and writes to the HAL on a thread of its own. Queued
+ 	values are written before this returns.
+ */
+void SndCtlControlServerRun(SndCtlControlServerRef server);
+
+/**
+ Make \c SndCtlControlServerRun() return.
+ @discussion Safe to call from a signal handler or any thread.
+ */
+void SndCtlControlServerStop(SndCtlControlServerRef server);
+
+/**
+ Get a server's counters.
+ */
+SndCtlControlServerStatistics SndCtlControlServerGetStatistics(SndCtlControlServerRef server);
+
+/**
+ Close a server's socket and free it.
+ */
+void SndCtlControlServerRelease(SndCtlControlServerRef server);
+
+#endif /* SndCtlControlServer_h */
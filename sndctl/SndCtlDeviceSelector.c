@@ -0,0 +1,340 @@
+//
+//  SndCtlDeviceSelector.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlDeviceSelector.h"
+#include "SndCtlError.h"
+#include <ctype.h>
+
+typedef enum {
+	SndCtlSelectorKeyID,
+	SndCtlSelectorKeyName,
+	SndCtlSelectorKeyUID,
+	SndCtlSelectorKeyManufacturer,
+	SndCtlSelectorKeyTransport,
+	SndCtlSelectorKeyChannels,
+	SndCtlSelectorKeyHas,
+} SndCtlSelectorKey;
+
+typedef enum {
+	SndCtlSelectorOpEqual,
+	SndCtlSelectorOpNotEqual,
+	SndCtlSelectorOpContains,
+	SndCtlSelectorOpLess,
+	SndCtlSelectorOpLessOrEqual,
+	SndCtlSelectorOpGreater,
+	SndCtlSelectorOpGreaterOrEqual,
+} SndCtlSelectorOp;
+
+typedef struct {
+	SndCtlSelectorKey key;
+	SndCtlSelectorOp op;
+	/// The attribute the term reads; \c 0 for the device ID, which is always present.
+	SndCtlDeviceField field;
+	/// Case-folded, to compare with the table's folded strings.
+	char *string;
+	UInt32 number;
+} SndCtlSelectorTerm;
+
+struct SndCtlDeviceSelector {
+	size_t count;
+	SndCtlDeviceField fields;
+	SndCtlSelectorTerm terms[];
+};
+
+static const struct {
+	const char *name;
+	SndCtlSelectorKey key;
+	SndCtlDeviceField field;
+} kSndCtlSelectorKeys[] = {
+	{ "id",				SndCtlSelectorKeyID,			0 },
+	{ "name",			SndCtlSelectorKeyName,			SndCtlDeviceFieldName },
+	{ "uid",			SndCtlSelectorKeyUID,			SndCtlDeviceFieldUID },
+	{ "manufacturer",	SndCtlSelectorKeyManufacturer,	SndCtlDeviceFieldManufacturer },
+	{ "transport",		SndCtlSelectorKeyTransport,		SndCtlDeviceFieldTransportType },
+	{ "channels",		SndCtlSelectorKeyChannels,		SndCtlDeviceFieldChannels },
+	{ "has",			SndCtlSelectorKeyHas,			0 },
+};
+
+static char *SndCtlTrim(char *str) {
+	while (isspace((unsigned char)*str))
+		++str;
+
+	char *end = str + strlen(str);
+
+	while (end > str && isspace((unsigned char)end[-1]))
+		*--end = '\0';
+
+	return str;
+}
+
+static size_t SndCtlSelectorKeyIndex(const char *keyString, size_t length) {
+	size_t keyCount = sizeof(kSndCtlSelectorKeys) / sizeof(kSndCtlSelectorKeys[0]);
+	size_t keyIndex = 0;
+
+	while (keyIndex < keyCount && (strlen(kSndCtlSelectorKeys[keyIndex].name) != length || strncasecmp(kSndCtlSelectorKeys[keyIndex].name, keyString, length) != 0))
+		++keyIndex;
+
+	return keyIndex;
+}
+
+// Returns whether a string starts with a known key and an operator, which is what sets a selector
+// apart from a plain device name like "Yeti!".
+static bool SndCtlSelectorStartsWithTerm(const char *string) {
+	while (isspace((unsigned char)*string))
+		++string;
+
+	const char *keyEnd = string;
+
+	while (isalpha((unsigned char)*keyEnd))
+		++keyEnd;
+
+	if (SndCtlSelectorKeyIndex(string, keyEnd - string) == sizeof(kSndCtlSelectorKeys) / sizeof(kSndCtlSelectorKeys[0]))
+		return false;
+
+	while (isspace((unsigned char)*keyEnd))
+		++keyEnd;
+
+	return *keyEnd != '\0' && strchr("=!~<>", *keyEnd) != NULL;
+}
+
+static bool SndCtlSelectorParseTerm(char *termString, SndCtlSelectorTerm *term) {
+	char *opStart = strpbrk(termString, "=!~<>");
+
+	if (!opStart)
+		return false;
+
+	char *value = opStart + 1;
+
+	switch (*opStart) {
+		case '=':
+			term->op = SndCtlSelectorOpEqual;
+			break;
+		case '~':
+			term->op = SndCtlSelectorOpContains;
+			break;
+		case '!':
+			if (*value != '=')
+				return false;
+			term->op = SndCtlSelectorOpNotEqual;
+			++value;
+			break;
+		case '<':
+			term->op = *value == '=' ? SndCtlSelectorOpLessOrEqual : SndCtlSelectorOpLess;
+			if (*value == '=')
+				++value;
+			break;
+		case '>':
+			term->op = *value == '=' ? SndCtlSelectorOpGreaterOrEqual : SndCtlSelectorOpGreater;
+			if (*value == '=')
+				++value;
+			break;
+	}
+
+	*opStart = '\0';
+	char *keyString = SndCtlTrim(termString);
+	value = SndCtlTrim(value);
+
+	size_t keyIndex = SndCtlSelectorKeyIndex(keyString, strlen(keyString));
+
+	if (keyIndex == sizeof(kSndCtlSelectorKeys) / sizeof(kSndCtlSelectorKeys[0]))
+		return false;
+
+	term->key = kSndCtlSelectorKeys[keyIndex].key;
+	term->field = kSndCtlSelectorKeys[keyIndex].field;
+	bool isOrdering = term->op >= SndCtlSelectorOpLess;
+
+	switch (term->key) {
+		case SndCtlSelectorKeyName:
+		case SndCtlSelectorKeyUID:
+		case SndCtlSelectorKeyManufacturer:
+			if (isOrdering)
+				return false;
+
+			term->string = SndCtlCopyFoldedString(value);
+			return term->string != NULL;
+		case SndCtlSelectorKeyID:
+		case SndCtlSelectorKeyChannels: {
+			char *endptr;
+			term->number = (UInt32)strtoul(value, &endptr, 10);
+			return term->op != SndCtlSelectorOpContains && endptr != value && *endptr == '\0';
+		}
+		case SndCtlSelectorKeyTransport:
+			if (term->op != SndCtlSelectorOpEqual && term->op != SndCtlSelectorOpNotEqual)
+				return false;
+
+			return SndCtlTransportTypeForName(value, &term->number);
+		case SndCtlSelectorKeyHas:
+			if (term->op != SndCtlSelectorOpEqual && term->op != SndCtlSelectorOpNotEqual)
+				return false;
+
+			if (strcasecmp(value, "volume") == 0)
+				term->field = SndCtlDeviceFieldHasMainVolume;
+			else if (strcasecmp(value, "balance") == 0)
+				term->field = SndCtlDeviceFieldHasMainBalance;
+			else
+				return false;
+
+			return true;
+	}
+
+	return false;
+}
+
+SndCtlDeviceSelectorRef SndCtlDeviceSelectorCreate(const char *string, CFErrorRef *error) {
+	// Plain strings keep working as name matches, even if they have operator characters in them.
+	if (!SndCtlSelectorStartsWithTerm(string)) {
+		SndCtlDeviceSelectorRef selector = malloc(sizeof(struct SndCtlDeviceSelector) + sizeof(SndCtlSelectorTerm));
+		selector->count = 1;
+		selector->fields = SndCtlDeviceFieldName | SndCtlDeviceFieldFoldedStrings;
+		selector->terms[0] = (SndCtlSelectorTerm){
+			.key = SndCtlSelectorKeyName,
+			.op = SndCtlSelectorOpContains,
+			.field = SndCtlDeviceFieldName,
+			.string = SndCtlCopyFoldedString(string),
+		};
+
+		if (!selector->terms[0].string) {
+			if (error)
+				*error = SndCtlErrorCreate(SndCtlErrorInvalidSelector, CFSTR("Device names must be UTF-8."));
+
+			SndCtlDeviceSelectorRelease(selector);
+			return NULL;
+		}
+
+		return selector;
+	}
+
+	size_t termCount = 1;
+
+	for (const char *c = string; *c; ++c) {
+		if (*c == ',')
+			++termCount;
+	}
+
+	SndCtlDeviceSelectorRef selector = calloc(1, sizeof(struct SndCtlDeviceSelector) + termCount * sizeof(SndCtlSelectorTerm));
+	char *copy = strdup(string);
+	char *cursor = copy;
+	char *termString;
+
+	while ((termString = strsep(&cursor, ",")) != NULL) {
+		SndCtlSelectorTerm *term = &selector->terms[selector->count];
+
+		if (!SndCtlSelectorParseTerm(termString, term)) {
+			if (error) {
+				CFStringRef description = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("Invalid device selector term '%s'."), SndCtlTrim(termString));
+				*error = SndCtlErrorCreate(SndCtlErrorInvalidSelector, description);
+				CFRelease(description);
+			}
+
+			free(copy);
+			SndCtlDeviceSelectorRelease(selector);
+			return NULL;
+		}
+
+		selector->fields |= term->field;
+
+		if (term->string)
+			selector->fields |= SndCtlDeviceFieldFoldedStrings;
+
+		++selector->count;
+	}
+
+	free(copy);
+
+	return selector;
+}
+
+void SndCtlDeviceSelectorRelease(SndCtlDeviceSelectorRef selector) {
+	if (!selector)
+		return;
+
+	for (size_t i = 0; i < selector->count; ++i)
+		free(selector->terms[i].string);
+
+	free(selector);
+}
+
+SndCtlDeviceField SndCtlDeviceSelectorRequiredFields(SndCtlDeviceSelectorRef selector) {
+	return selector->fields;
+}
+
+static bool SndCtlSelectorCompareNumbers(SndCtlSelectorOp op, UInt32 lhs, UInt32 rhs) {
+	switch (op) {
+		case SndCtlSelectorOpEqual:
+			return lhs == rhs;
+		case SndCtlSelectorOpNotEqual:
+			return lhs != rhs;
+		case SndCtlSelectorOpLess:
+			return lhs < rhs;
+		case SndCtlSelectorOpLessOrEqual:
+			return lhs <= rhs;
+		case SndCtlSelectorOpGreater:
+			return lhs > rhs;
+		case SndCtlSelectorOpGreaterOrEqual:
+			return lhs >= rhs;
+		case SndCtlSelectorOpContains:
+			break;
+	}
+
+	return false;
+}
+
+// Both strings are already case-folded, so plain byte comparisons are case-insensitive.
+static bool SndCtlSelectorCompareStrings(SndCtlSelectorOp op, const char *lhs, const char *rhs) {
+	if (!lhs)
+		return false;
+
+	switch (op) {
+		case SndCtlSelectorOpEqual:
+			return strcmp(lhs, rhs) == 0;
+		case SndCtlSelectorOpNotEqual:
+			return strcmp(lhs, rhs) != 0;
+		case SndCtlSelectorOpContains:
+			return strstr(lhs, rhs) != NULL;
+		default:
+			return false;
+	}
+}
+
+static bool SndCtlSelectorTermMatches(const SndCtlSelectorTerm *term, const SndCtlDeviceInfo *device) {
+	if ((device->fields & term->field) != term->field)
+		return false;
+
+	switch (term->key) {
+		case SndCtlSelectorKeyID:
+			return SndCtlSelectorCompareNumbers(term->op, device->deviceid, term->number);
+		case SndCtlSelectorKeyName:
+			return SndCtlSelectorCompareStrings(term->op, device->foldedName, term->string);
+		case SndCtlSelectorKeyUID:
+			return SndCtlSelectorCompareStrings(term->op, device->foldedUID, term->string);
+		case SndCtlSelectorKeyManufacturer:
+			return SndCtlSelectorCompareStrings(term->op, device->foldedManufacturer, term->string);
+		case SndCtlSelectorKeyTransport:
+			return SndCtlSelectorCompareNumbers(term->op, device->transportType, term->number);
+		case SndCtlSelectorKeyChannels:
+			return SndCtlSelectorCompareNumbers(term->op, device->channels, term->number);
+		case SndCtlSelectorKeyHas: {
+			bool has = term->field == SndCtlDeviceFieldHasMainVolume ? device->hasMainVolume : device->hasMainBalance;
+			return term->op == SndCtlSelectorOpEqual ? has : !has;
+		}
+	}
+
+	return false;
+}
+
+bool SndCtlDeviceSelectorMatches(SndCtlDeviceSelectorRef selector, const SndCtlDeviceInfo *device) {
+	if (device->unresponsive)
+		return false;
+
+	for (size_t i = 0; i < selector->count; ++i) {
+		if (!SndCtlSelectorTermMatches(&selector->terms[i], device))
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,61 @@
+//
+//  SndCtlDeviceSelector.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlDeviceSelector_h
+#define SndCtlDeviceSelector_h
+
+#include "SndCtlDeviceTable.h"
+
+/**
+ A compiled device selector.
+
+ A selector is a comma-separated list of terms, all of which must match:
+
+ 	key op value
+
+ where \c key is one of \c id\n, \c name\n, \c uid\n, \c manufacturer\n, \c transport\n,
+ \c channels or \c has\n, and \c op is one of \c =\n, \c !=\n, \c ~ (contains),
+ \c <\n, \c <=\n, \c > or \c >=\n. Strings are compared ignoring case, using Unicode case
+ folding (see \c SndCtlCopyFoldedString()\n). \c transport takes a name like \c usb or
+ \c bluetooth\n; \c has takes \c volume or \c balance\n.
+
+ A string that doesn't start with a key and an operator is treated as \c name~string\n, so
+ device names with operator characters in them, like \c "Yeti!"\n, still work.
+
+ For example: \c "transport=usb,channels>=8"\n.
+ */
+typedef struct SndCtlDeviceSelector *SndCtlDeviceSelectorRef;
+
+/**
+ Compile a selector.
+ @param string	The selector.
+ @param error	An error on failure.
+ @return A new selector, or \c NULL if \c string couldn't be parsed.
+ 	Free it with \c SndCtlDeviceSelectorRelease()\n.
+ */
+SndCtlDeviceSelectorRef SndCtlDeviceSelectorCreate(const char *string, CFErrorRef *error);
+
+/**
+ Free a selector.
+ */
+void SndCtlDeviceSelectorRelease(SndCtlDeviceSelectorRef selector);
+
+/**
+ Get the device attributes a selector needs to be evaluated.
+ @discussion Pass these to \c SndCtlDeviceTableCreate()\n.
+ */
+SndCtlDeviceField SndCtlDeviceSelectorRequiredFields(SndCtlDeviceSelectorRef selector);
+
+/**
+ Returns whether a device matches a selector.
+ @discussion Terms on attributes that weren't fetched for \c device don't match, and
+ 	unresponsive devices never match.
+ */
+bool SndCtlDeviceSelectorMatches(SndCtlDeviceSelectorRef selector, const SndCtlDeviceInfo *device);
+
+#endif /* SndCtlDeviceSelector_h */
@@ -0,0 +1,347 @@
+//
+//  SndCtlDeviceTable.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlDeviceTable.h"
+#include "SndCtlAudioUtils.h"
+#include "SndCtlError.h"
+#include "SndCtlHAL.h"
+#include "SndCtlParallel.h"
+#include <errno.h>
+#include <stddef.h>
+#include <pthread.h>
+
+static const struct {
+	UInt32 transportType;
+	const char *name;
+} kSndCtlTransportTypeNames[] = {
+	{ kAudioDeviceTransportTypeBuiltIn,		"builtin" },
+	{ kAudioDeviceTransportTypeAggregate,	"aggregate" },
+	{ kAudioDeviceTransportTypeVirtual,		"virtual" },
+	{ kAudioDeviceTransportTypePCI,			"pci" },
+	{ kAudioDeviceTransportTypeUSB,			"usb" },
+	{ kAudioDeviceTransportTypeFireWire,	"firewire" },
+	{ kAudioDeviceTransportTypeBluetooth,	"bluetooth" },
+	{ kAudioDeviceTransportTypeBluetoothLE,	"bluetoothle" },
+	{ kAudioDeviceTransportTypeHDMI,		"hdmi" },
+	{ kAudioDeviceTransportTypeDisplayPort,	"displayport" },
+	{ kAudioDeviceTransportTypeAirPlay,		"airplay" },
+	{ kAudioDeviceTransportTypeAVB,			"avb" },
+	{ kAudioDeviceTransportTypeThunderbolt,	"thunderbolt" },
+};
+
+const char *SndCtlNameForTransportType(UInt32 transportType) {
+	for (size_t i = 0; i < sizeof(kSndCtlTransportTypeNames) / sizeof(kSndCtlTransportTypeNames[0]); ++i) {
+		if (kSndCtlTransportTypeNames[i].transportType == transportType)
+			return kSndCtlTransportTypeNames[i].name;
+	}
+
+	return "unknown";
+}
+
+bool SndCtlTransportTypeForName(const char *name, UInt32 *transportType) {
+	for (size_t i = 0; i < sizeof(kSndCtlTransportTypeNames) / sizeof(kSndCtlTransportTypeNames[0]); ++i) {
+		if (strcasecmp(kSndCtlTransportTypeNames[i].name, name) == 0) {
+			*transportType = kSndCtlTransportTypeNames[i].transportType;
+			return true;
+		}
+	}
+
+	// Common shorthand.
+	if (strcasecmp(name, "bt") == 0) {
+		*transportType = kAudioDeviceTransportTypeBluetooth;
+		return true;
+	}
+
+	return false;
+}
+
+static CFStringRef SndCtlCopyStringPropertyOfDeviceID(AudioObjectID deviceid, AudioObjectPropertySelector selector) {
+	AudioObjectPropertyAddress theAddress = {
+		selector,
+		kAudioObjectPropertyScopeGlobal,
+		kAudioObjectPropertyElementMaster
+	};
+
+	CFStringRef string = NULL;
+	UInt32 size = sizeof(string);
+
+	if (SndCtlHALGetPropertyData(deviceid, &theAddress, 0, NULL, &size, &string) != kAudioHardwareNoError)
+		return NULL;
+
+	return string;
+}
+
+// Returns a malloc()ed UTF-8 copy of a string with Unicode case folding applied.
+static char *SndCtlCopyFoldedCFString(CFStringRef string) {
+	CFMutableStringRef folded = CFStringCreateMutableCopy(kCFAllocatorDefault, 0, string);
+
+	if (!folded)
+		return NULL;
+
+	CFStringFold(folded, kCFCompareCaseInsensitive, NULL);
+
+	CFIndex size = CFStringGetMaximumSizeForEncoding(CFStringGetLength(folded), kCFStringEncodingUTF8) + 1;
+	char *utf8 = malloc(size);
+
+	if (utf8 && !CFStringGetCString(folded, utf8, size, kCFStringEncodingUTF8)) {
+		free(utf8);
+		utf8 = NULL;
+	}
+
+	CFRelease(folded);
+
+	return utf8;
+}
+
+char *SndCtlCopyFoldedString(const char *string) {
+	CFStringRef cfString = CFStringCreateWithCString(kCFAllocatorDefault, string, kCFStringEncodingUTF8);
+
+	if (!cfString)
+		return NULL;
+
+	char *folded = SndCtlCopyFoldedCFString(cfString);
+	CFRelease(cfString);
+
+	return folded;
+}
+
+// Moves a string returned by the HAL into the table's arena as UTF-8, along with a case-folded
+// copy if folded isn't NULL, releasing the original.
+static const char *SndCtlDeviceTableAdoptString(SndCtlArenaRef arena, pthread_mutex_t *lock, CFStringRef string, const char **folded) {
+	if (!string)
+		return NULL;
+
+	char *foldedUTF8 = folded ? SndCtlCopyFoldedCFString(string) : NULL;
+
+	const char *utf8 = CFStringGetCStringPtr(string, kCFStringEncodingUTF8);
+	char buffer[utf8 ? 1 : CFStringGetMaximumSizeForEncoding(CFStringGetLength(string), kCFStringEncodingUTF8) + 1];
+
+	if (!utf8 && CFStringGetCString(string, buffer, sizeof(buffer), kCFStringEncodingUTF8))
+		utf8 = buffer;
+
+	char *copy = NULL;
+
+	if (utf8) {
+		pthread_mutex_lock(lock);
+		copy = SndCtlArenaCopyString(arena, utf8);
+
+		if (copy && foldedUTF8)
+			*folded = SndCtlArenaCopyString(arena, foldedUTF8);
+
+		pthread_mutex_unlock(lock);
+	}
+
+	free(foldedUTF8);
+	CFRelease(string);
+
+	return copy;
+}
+
+// Reads a fixed-size property into value, leaving it untouched on failure.
+static void SndCtlGetScalarPropertyOfDeviceID(AudioObjectID deviceid, AudioObjectPropertySelector selector, void *value, UInt32 size) {
+	AudioObjectPropertyAddress theAddress = {
+		selector,
+		kAudioObjectPropertyScopeGlobal,
+		kAudioObjectPropertyElementMaster
+	};
+
+	UInt32 propSize = size;
+	UInt8 buffer[size];
+
+	if (SndCtlHALGetPropertyData(deviceid, &theAddress, 0, NULL, &propSize, buffer) == kAudioHardwareNoError && propSize == size)
+		memcpy(value, buffer, size);
+}
+
+// Returns whether a device has any output streams, which is cheaper to find out than its channel count.
+static bool SndCtlDeviceIDHasOutputStreams(AudioObjectID deviceid) {
+	AudioObjectPropertyAddress theAddress = {
+		kAudioDevicePropertyStreamConfiguration,
+		kAudioDevicePropertyScopeOutput,
+		0
+	};
+
+	UInt32 propSize;
+
+	if (SndCtlHALGetPropertyDataSize(deviceid, &theAddress, 0, NULL, &propSize) != kAudioHardwareNoError)
+		return false;
+
+	return propSize > offsetof(AudioBufferList, mBuffers);
+}
+
+static void SndCtlDeviceInfoFetch(SndCtlDeviceInfo *info, SndCtlDeviceField fields, SndCtlArenaRef arena, pthread_mutex_t *arenaLock) {
+	AudioObjectID deviceid = info->deviceid;
+	bool fold = fields & SndCtlDeviceFieldFoldedStrings;
+
+	if (fields & SndCtlDeviceFieldName)
+		info->name = SndCtlDeviceTableAdoptString(arena, arenaLock, SndCtlCopyNameOfDeviceID(deviceid, NULL), fold ? &info->foldedName : NULL);
+	if (fields & SndCtlDeviceFieldUID)
+		info->uid = SndCtlDeviceTableAdoptString(arena, arenaLock, SndCtlCopyStringPropertyOfDeviceID(deviceid, kAudioDevicePropertyDeviceUID), fold ? &info->foldedUID : NULL);
+	if (fields & SndCtlDeviceFieldManufacturer)
+		info->manufacturer = SndCtlDeviceTableAdoptString(arena, arenaLock, SndCtlCopyStringPropertyOfDeviceID(deviceid, kAudioObjectPropertyManufacturer), fold ? &info->foldedManufacturer : NULL);
+	if (fields & SndCtlDeviceFieldTransportType)
+		SndCtlGetScalarPropertyOfDeviceID(deviceid, kAudioDevicePropertyTransportType, &info->transportType, sizeof(info->transportType));
+	if (fields & SndCtlDeviceFieldChannels)
+		info->channels = SndCtlNumberOfChannelsOfDeviceID(deviceid, NULL);
+	if (fields & SndCtlDeviceFieldHasMainVolume)
+		info->hasMainVolume = SndCtlOutputDeviceHasMainVolume(deviceid);
+	if (fields & SndCtlDeviceFieldHasMainBalance)
+		info->hasMainBalance = SndCtlOutputDeviceHasMainBalance(deviceid);
+	if (fields & SndCtlDeviceFieldVolume)
+		info->volume = SndCtlGetVolume(deviceid, NULL);
+	if (fields & SndCtlDeviceFieldBalance)
+		info->balance = SndCtlGetBalance(deviceid, NULL);
+	if (fields & SndCtlDeviceFieldSampleRate)
+		SndCtlGetScalarPropertyOfDeviceID(deviceid, kAudioDevicePropertyNominalSampleRate, &info->sampleRate, sizeof(info->sampleRate));
+	if (fields & SndCtlDeviceFieldBufferFrameSize)
+		SndCtlGetScalarPropertyOfDeviceID(deviceid, kAudioDevicePropertyBufferFrameSize, &info->bufferFrameSize, sizeof(info->bufferFrameSize));
+	if (fields & SndCtlDeviceFieldLatency) {
+		SndCtlOutputLatency latency;
+
+		if (SndCtlGetOutputLatency(deviceid, &latency, NULL))
+			info->latencyFrames = SndCtlOutputLatencyTotalFrames(&latency);
+	}
+
+	info->fields |= fields;
+}
+
+// Arena space reserved per device for its name, UID and manufacturer.
+static const size_t kSndCtlDeviceTableStringBytesPerDevice = 128;
+
+typedef struct {
+	const AudioObjectID *deviceids;
+	UInt32 deviceCount;
+	SndCtlDeviceField fields;
+	/// One slot per entry in \c deviceids\n; \c deviceid is left \c kAudioObjectUnknown for devices that aren't outputs.
+	SndCtlDeviceInfo *infos;
+	SndCtlArenaRef arena;
+	/// Guards \c arena\n.
+	pthread_mutex_t lock;
+} SndCtlDeviceTableFetch;
+
+static void SndCtlDeviceTableFetchDevice(void *context, size_t i) {
+	SndCtlDeviceTableFetch *fetch = context;
+	SndCtlDeviceInfo *info = &fetch->infos[i];
+	AudioObjectID deviceid = fetch->deviceids[i];
+	SndCtlDeviceField fields = fetch->fields;
+	bool isOutput;
+
+	// If the channel count was asked for anyway, it doubles as the output check.
+	if (fields & SndCtlDeviceFieldChannels) {
+		info->channels = SndCtlNumberOfChannelsOfDeviceID(deviceid, NULL);
+		info->fields = SndCtlDeviceFieldChannels;
+		isOutput = info->channels > 0;
+	} else
+		isOutput = SndCtlDeviceIDHasOutputStreams(deviceid);
+
+	// A device that timed out can't be ruled out, so it's listed as unresponsive instead.
+	info->unresponsive = SndCtlHALObjectIsUnresponsive(deviceid);
+
+	if (!isOutput && !info->unresponsive) {
+		info->fields = 0;
+		return;
+	}
+
+	info->deviceid = deviceid;
+	info->fields |= fields & SndCtlDeviceFieldStatus;
+	info->volume = NAN;
+	info->balance = NAN;
+
+	if (!info->unresponsive) {
+		SndCtlDeviceInfoFetch(info, fields & ~info->fields, fetch->arena, &fetch->lock);
+		info->unresponsive = SndCtlHALObjectIsUnresponsive(deviceid);
+	}
+}
+
+static int SndCtlDeviceInfoCompareIDs(const void *lhs, const void *rhs) {
+	AudioObjectID lhsid = ((const SndCtlDeviceInfo *)lhs)->deviceid;
+	AudioObjectID rhsid = ((const SndCtlDeviceInfo *)rhs)->deviceid;
+
+	return lhsid < rhsid ? -1 : lhsid > rhsid;
+}
+
+SndCtlDeviceTable *SndCtlDeviceTableCreate(SndCtlDeviceField fields, CFErrorRef *error) {
+	AudioObjectPropertyAddress theAddress = {
+		kAudioHardwarePropertyDevices,
+		kAudioObjectPropertyScopeGlobal,
+		kAudioObjectPropertyElementMaster
+	};
+
+	UInt32 propsize;
+	OSStatus result = SndCtlHALGetPropertyDataSize(kAudioObjectSystemObject, &theAddress, 0, NULL, &propsize);
+
+	if (result != kAudioHardwareNoError) {
+		if (error)
+			*error = SndCtlErrorCreateWithOSStatus(result, CFSTR("Couldn't copy audio output devices."));
+
+		return NULL;
+	}
+
+	// Room for the device list, the table and a typical device's strings, so most snapshots fit in one allocation.
+	UInt32 deviceCapacity = propsize / sizeof(AudioObjectID) + 1;
+	SndCtlArenaRef arena = SndCtlArenaCreate(sizeof(SndCtlDeviceTable) + deviceCapacity * (sizeof(AudioObjectID) + sizeof(SndCtlDeviceInfo) + kSndCtlDeviceTableStringBytesPerDevice));
+	AudioObjectID *allDevices = arena ? SndCtlArenaAlloc(arena, deviceCapacity * sizeof(AudioObjectID)) : NULL;
+	SndCtlDeviceTable *table = allDevices ? SndCtlArenaAlloc(arena, sizeof(SndCtlDeviceTable)) : NULL;
+	SndCtlDeviceInfo *infos = table ? SndCtlArenaAlloc(arena, deviceCapacity * sizeof(SndCtlDeviceInfo)) : NULL;
+
+	if (!infos) {
+		if (error)
+			*error = SndCtlErrorCreateWithPOSIXCode(ENOMEM, CFSTR("Couldn't copy audio output devices."));
+
+		SndCtlArenaRelease(arena);
+		return NULL;
+	}
+
+	result = SndCtlHALGetPropertyData(kAudioObjectSystemObject, &theAddress, 0, NULL, &propsize, allDevices);
+
+	if (result != kAudioHardwareNoError) {
+		if (error)
+			*error = SndCtlErrorCreateWithOSStatus(result, CFSTR("Couldn't copy audio output devices."));
+
+		SndCtlArenaRelease(arena);
+		return NULL;
+	}
+
+	UInt32 deviceCount = propsize / sizeof(AudioObjectID);
+	table->arena = arena;
+
+	SndCtlDeviceTableFetch fetch = {
+		.deviceids = allDevices,
+		.deviceCount = deviceCount,
+		.fields = fields,
+		.infos = infos,
+		.arena = arena,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+	};
+
+	// Each device is a few sequential round trips, so fetch devices side by side.
+	SndCtlParallelFor(deviceCount, &fetch, SndCtlDeviceTableFetchDevice);
+
+	pthread_mutex_destroy(&fetch.lock);
+
+	// Drop the non-output slots, then order by ID so the table doesn't depend on which thread finished first.
+	table->devices = fetch.infos;
+	table->count = 0;
+
+	for (UInt32 i = 0; i < deviceCount; ++i) {
+		SndCtlDeviceInfo *info = &fetch.infos[i];
+
+		if (info->deviceid == kAudioObjectUnknown)
+			continue;
+
+		table->devices[table->count++] = *info;
+	}
+
+	qsort(table->devices, table->count, sizeof(SndCtlDeviceInfo), SndCtlDeviceInfoCompareIDs);
+
+	return table;
+}
+
+void SndCtlDeviceTableRelease(SndCtlDeviceTable *table) {
+	if (table)
+		SndCtlArenaRelease(table->arena);
+}
@@ -0,0 +1,129 @@
+//
+//  SndCtlDeviceTable.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlDeviceTable_h
+#define SndCtlDeviceTable_h
+
+#include <stdio.h>
+#include <AudioToolbox/AudioToolbox.h>
+#include "SndCtlArena.h"
+
+/// Attributes that can be fetched into a device table.
+typedef CF_OPTIONS(UInt32, SndCtlDeviceField) {
+	SndCtlDeviceFieldName				= 1 << 0,
+	SndCtlDeviceFieldUID				= 1 << 1,
+	SndCtlDeviceFieldManufacturer		= 1 << 2,
+	SndCtlDeviceFieldTransportType		= 1 << 3,
+	SndCtlDeviceFieldChannels			= 1 << 4,
+	SndCtlDeviceFieldHasMainVolume		= 1 << 5,
+	SndCtlDeviceFieldHasMainBalance		= 1 << 6,
+	SndCtlDeviceFieldVolume				= 1 << 7,
+	SndCtlDeviceFieldBalance			= 1 << 8,
+	SndCtlDeviceFieldSampleRate			= 1 << 9,
+	SndCtlDeviceFieldBufferFrameSize	= 1 << 10,
+	SndCtlDeviceFieldLatency			= 1 << 11,
+	/// \c unresponsive\n, which is always filled in and costs no extra HAL calls.
+	SndCtlDeviceFieldStatus				= 1 << 12,
+	/// Case-folded copies of whichever of the name, UID and manufacturer are fetched, for
+	/// \c SndCtlDeviceSelectorMatches()\n. These cost a CoreFoundation copy per string.
+	SndCtlDeviceFieldFoldedStrings		= 1 << 13,
+};
+
+/**
+ An output device and whichever of its attributes were fetched.
+ @discussion Only the members named in \c fields are valid.
+ */
+typedef struct {
+	AudioObjectID deviceid;
+	SndCtlDeviceField fields;
+	/// The device missed a HAL deadline, so some of its attributes may be missing.
+	bool unresponsive;
+
+	/// UTF-8; owned by the table.
+	const char *name;
+	/// UTF-8; owned by the table.
+	const char *uid;
+	/// UTF-8; owned by the table.
+	const char *manufacturer;
+	/// \c name case-folded with \c SndCtlCopyFoldedString()\n, for case-insensitive matching.
+	/// Only fetched with \c SndCtlDeviceFieldFoldedStrings\n, like the two below.
+	const char *foldedName;
+	/// \c uid case-folded with \c SndCtlCopyFoldedString()\n.
+	const char *foldedUID;
+	/// \c manufacturer case-folded with \c SndCtlCopyFoldedString()\n.
+	const char *foldedManufacturer;
+	UInt32 transportType;
+	UInt32 channels;
+	bool hasMainVolume;
+	bool hasMainBalance;
+	/// \c NAN if the device has no main volume.
+	Float32 volume;
+	/// \c NAN if the device has no main balance.
+	Float32 balance;
+	Float64 sampleRate;
+	UInt32 bufferFrameSize;
+	/// Total output latency in frames; see \c SndCtlGetOutputLatency()\n.
+	UInt32 latencyFrames;
+} SndCtlDeviceInfo;
+
+/// A snapshot of the available output devices.
+typedef struct {
+	CFIndex count;
+	SndCtlDeviceInfo *devices;
+	/// Holds the table itself, its devices and their strings.
+	SndCtlArenaRef arena;
+} SndCtlDeviceTable;
+
+/**
+ Fetch the output devices and the requested attributes in a single pass.
+ @param fields	The attributes to fetch. Nothing else is fetched beyond the single call per
+ 				device needed to tell output devices apart from the rest.
+ @param error	An error on failure.
+ @return A new table, or \c NULL on failure. Free it with \c SndCtlDeviceTableRelease()\n.
+ @discussion Devices are fetched concurrently on a small pool of threads, so this takes about
+ 	as long as the slowest device rather than the sum of all of them. The table is ordered by
+ 	device ID.
+
+ 	Devices that miss a HAL deadline (see \c SndCtlHALSetCallTimeout()\n) are kept in the
+ 	table but marked \c unresponsive\n.
+
+ 	The table and everything in it comes from one arena and holds no CoreFoundation objects, so
+ 	it's cheap to build and release repeatedly in a long-running process.
+ */
+SndCtlDeviceTable *SndCtlDeviceTableCreate(SndCtlDeviceField fields, CFErrorRef *error);
+
+/**
+ Free a device table and everything in it.
+ */
+void SndCtlDeviceTableRelease(SndCtlDeviceTable *table);
+
+/**
+ Get a short lowercase name for a transport type, e.g. \c "usb"\n.
+ @return The name, or \c "unknown" for unrecognized types.
+ */
+const char *SndCtlNameForTransportType(UInt32 transportType);
+
+/**
+ Get the transport type for a name returned by \c SndCtlNameForTransportType()\n.
+ @param name			The name, compared case-insensitively.
+ @param transportType	Set to the transport type on success.
+ @return Whether \c name is a known transport type.
+ */
+bool SndCtlTransportTypeForName(const char *name, UInt32 *transportType);
+
+/**
+ Case-fold a string so it can be compared case-insensitively with \c strcmp() and \c strstr()\n.
+ @param string	A UTF-8 string.
+ @return A \c malloc()ed UTF-8 copy with Unicode case folding applied, or \c NULL if \c string
+ 	isn't valid UTF-8.
+ @discussion Folding is done once when a device table is built, so matching a selector against
+ 	a table doesn't create any CoreFoundation objects.
+ */
+char *SndCtlCopyFoldedString(const char *string);
+
+#endif /* SndCtlDeviceTable_h */
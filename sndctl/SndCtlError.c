@@ -0,0 +1,63 @@
+//
+//  SndCtlError.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlError.h"
+#include "SndCtlHAL.h"
+#include <string.h>
+
+const CFStringRef kSndCtlErrorDomain = CFSTR("org.derailer.sndctl");
+
+CFErrorRef SndCtlErrorCreate(SndCtlErrorCode code, CFStringRef description) {
+	CFTypeRef keys[] = { kCFErrorLocalizedDescriptionKey };
+	CFTypeRef values[] = { description };
+
+	return CFErrorCreateWithUserInfoKeysAndValues(kCFAllocatorDefault, kSndCtlErrorDomain, code, keys, values, 1);
+}
+
+CFErrorRef SndCtlErrorCreateWithOSStatus(OSStatus status, CFStringRef localizedFailure) {
+	CFStringRef failureReason = NULL;
+
+	switch (status) {
+		case kAudioHardwareBadObjectError:
+		case kAudioHardwareBadDeviceError:
+			failureReason = CFSTR("Device doesn't exist.");
+			break;
+		case kAudioHardwareUnknownPropertyError:
+			failureReason = CFSTR("Device doesn't support the specified property.");
+			break;
+		case kSndCtlHALTimedOutError:
+			failureReason = CFSTR("Device didn't respond in time.");
+			break;
+		default:
+			break;
+	}
+
+	if (failureReason)
+		localizedFailure = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("%@: %@"), localizedFailure, failureReason);
+
+	CFTypeRef keys[] = { kCFErrorLocalizedDescriptionKey, kCFErrorLocalizedFailureReasonKey };
+	CFTypeRef values[] = { localizedFailure, failureReason };
+	CFErrorRef error = CFErrorCreateWithUserInfoKeysAndValues(kCFAllocatorDefault, kCFErrorDomainOSStatus, status, keys, values, failureReason ? 2 : 1);
+
+	if (failureReason)
+		CFRelease(localizedFailure);
+
+	return error;
+}
+
+CFErrorRef SndCtlErrorCreateWithPOSIXCode(int code, CFStringRef localizedFailure) {
+	CFStringRef description = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("%@: %s"), localizedFailure, strerror(code));
+
+	CFTypeRef keys[] = { kCFErrorLocalizedDescriptionKey };
+	CFTypeRef values[] = { description };
+	CFErrorRef error = CFErrorCreateWithUserInfoKeysAndValues(kCFAllocatorDefault, kCFErrorDomainPOSIX, code, keys, values, 1);
+
+	CFRelease(description);
+
+	return error;
+}
@@ -0,0 +1,60 @@
+//
+//  SndCtlError.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlError_h
+#define SndCtlError_h
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <AudioToolbox/AudioToolbox.h>
+
+/// Error domain for errors that don't come from the HAL or the system.
+extern const CFStringRef kSndCtlErrorDomain;
+
+/// Error codes in \c kSndCtlErrorDomain\n.
+typedef enum {
+	/// A device selector couldn't be parsed.
+	SndCtlErrorInvalidSelector = 1,
+	/// A value is outside what the device supports.
+	SndCtlErrorValueOutOfRange,
+	/// An asynchronous request was cancelled before it ran.
+	SndCtlErrorCancelled,
+	/// An asynchronous request was replaced by a newer one before it ran.
+	SndCtlErrorSuperseded,
+	/// A line in a rules file couldn't be parsed.
+	SndCtlErrorInvalidRule,
+	/// A property request or value couldn't be parsed, or the property's type can't be set.
+	SndCtlErrorInvalidProperty,
+	/// A device isn't alive, has no outputs or can't be the default output device.
+	SndCtlErrorDeviceUnavailable,
+} SndCtlErrorCode;
+
+/**
+ Create an error in the sndctl domain.
+ @param code			The error code.
+ @param description	The localized description.
+ @return A new error in the \c kSndCtlErrorDomain domain. The caller must release it.
+ */
+CFErrorRef SndCtlErrorCreate(SndCtlErrorCode code, CFStringRef description);
+
+/**
+ Create an error from an \c OSStatus returned by the HAL.
+ @param status				The status code.
+ @param localizedFailure	A description of what failed.
+ @return A new error in the \c kCFErrorDomainOSStatus domain. The caller must release it.
+ */
+CFErrorRef SndCtlErrorCreateWithOSStatus(OSStatus status, CFStringRef localizedFailure);
+
+/**
+ Create an error from a POSIX error number.
+ @param code				The error number, usually \c errno\n.
+ @param localizedFailure	A description of what failed.
+ @return A new error in the \c kCFErrorDomainPOSIX domain. The caller must release it.
+ */
+CFErrorRef SndCtlErrorCreateWithPOSIXCode(int code, CFStringRef localizedFailure);
+
+#endif /* SndCtlError_h */
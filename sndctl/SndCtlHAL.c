@@ -0,0 +1,834 @@
+//
+//  SndCtlHAL.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlHAL.h"
+#include "SndCtlError.h"
+#include <pthread.h>
+#include <dispatch/dispatch.h>
+#include <time.h>
+
+static const char kSndCtlHALLogMagic[4] = { 'S', 'C', 'H', 'L' };
+static const UInt32 kSndCtlHALLogVersion = 2;
+/// Version 1 logs had no null-string flags, so their \c NULL strings replay as empty ones.
+static const UInt32 kSndCtlHALLogOldestVersion = 1;
+
+typedef enum {
+	SndCtlHALOperationGetPropertyDataSize = 1,
+	SndCtlHALOperationGetPropertyData,
+	SndCtlHALOperationSetPropertyData,
+	SndCtlHALOperationHasProperty,
+} SndCtlHALOperation;
+
+enum {
+	/// The data is a \c CFStringRef\n, logged as UTF-8.
+	SndCtlHALEncodingDataIsString = 1 << 0,
+	/// The qualifier is a \c CFStringRef\n, logged as UTF-8.
+	SndCtlHALEncodingQualifierIsString = 1 << 1,
+	/// The input string was \c NULL rather than empty.
+	SndCtlHALEncodingInputIsNull = 1 << 2,
+	/// The output string was \c NULL rather than empty.
+	SndCtlHALEncodingOutputIsNull = 1 << 3,
+};
+
+typedef struct {
+	UInt64 duration;
+	AudioObjectID objectid;
+	AudioObjectPropertyAddress address;
+	OSStatus status;
+	UInt32 qualifierSize;
+	UInt32 inputSize;
+	UInt32 outputSize;
+	/// The size (or, for \c SndCtlHALOperationHasProperty\n, the result) handed back to the caller.
+	UInt32 resultSize;
+	UInt8 operation;
+	UInt8 encoding;
+	UInt16 reserved;
+} SndCtlHALRecordHeader;
+
+typedef struct {
+	SndCtlHALRecordHeader header;
+	const UInt8 *qualifier;
+	const UInt8 *input;
+	const UInt8 *output;
+	bool used;
+} SndCtlHALReplayEntry;
+
+static pthread_mutex_t gHALLock = PTHREAD_MUTEX_INITIALIZER;
+static SndCtlHALBackend gBackend = SndCtlHALBackendLive;
+
+static FILE *gRecordFile = NULL;
+
+static UInt8 *gReplayBytes = NULL;
+static SndCtlHALReplayEntry *gReplayEntries = NULL;
+static size_t gReplayCount = 0;
+static size_t gReplayFirstUnused = 0;
+static double gReplayLatencyScale = 1.0;
+static UInt64 gReplayLatency = 0;
+
+static UInt64 gCallTimeout = 0;
+static UInt64 gDeadline = 0;
+static AudioObjectID *gUnresponsiveObjects = NULL;
+static size_t gUnresponsiveCount = 0;
+
+static UInt64 gCallCount = 0;
+
+static bool SndCtlHALPropertyIsString(AudioObjectPropertySelector selector) {
+	switch (selector) {
+		case kAudioObjectPropertyName:
+		case kAudioObjectPropertyManufacturer:
+		case kAudioObjectPropertyModelName:
+		case kAudioObjectPropertyElementName:
+		case kAudioObjectPropertySerialNumber:
+		case kAudioObjectPropertyFirmwareVersion:
+		case kAudioObjectPropertyCreator:
+		case kAudioDevicePropertyDeviceUID:
+		case kAudioDevicePropertyModelUID:
+		case kAudioDevicePropertyConfigurationApplication:
+		case kAudioDevicePropertyClockDevice:
+			return true;
+		default:
+			return false;
+	}
+}
+
+static bool SndCtlHALQualifierIsString(AudioObjectPropertySelector selector) {
+	return selector == kAudioHardwarePropertyTranslateUIDToDevice;
+}
+
+static UInt64 SndCtlHALNow(void) {
+	return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+// Returns a malloc()ed UTF-8 copy of a string, without a terminator.
+static UInt8 *SndCtlHALCopyUTF8(CFStringRef string, UInt32 *length) {
+	*length = 0;
+
+	if (!string)
+		return NULL;
+
+	CFRange range = CFRangeMake(0, CFStringGetLength(string));
+	CFIndex maxLength = CFStringGetMaximumSizeForEncoding(range.length, kCFStringEncodingUTF8);
+	UInt8 *bytes = malloc(maxLength > 0 ? maxLength : 1);
+	CFIndex usedLength = 0;
+
+	CFStringGetBytes(string, range, kCFStringEncodingUTF8, 0, false, bytes, maxLength, &usedLength);
+	*length = (UInt32)usedLength;
+
+	return bytes;
+}
+
+static void SndCtlHALRecord(SndCtlHALRecordHeader header, const void *qualifier, const void *input, const void *output) {
+	UInt8 *qualifierBytes = NULL;
+	UInt8 *inputBytes = NULL;
+	UInt8 *outputBytes = NULL;
+
+	if (header.qualifierSize && SndCtlHALQualifierIsString(header.address.mSelector)) {
+		header.encoding |= SndCtlHALEncodingQualifierIsString;
+		qualifier = qualifierBytes = SndCtlHALCopyUTF8(*(CFStringRef *)qualifier, &header.qualifierSize);
+	}
+
+	if (SndCtlHALPropertyIsString(header.address.mSelector)) {
+		header.encoding |= SndCtlHALEncodingDataIsString;
+
+		if (header.inputSize == sizeof(CFStringRef)) {
+			if (!*(CFStringRef *)input)
+				header.encoding |= SndCtlHALEncodingInputIsNull;
+
+			input = inputBytes = SndCtlHALCopyUTF8(*(CFStringRef *)input, &header.inputSize);
+		}
+
+		if (header.outputSize == sizeof(CFStringRef)) {
+			if (!*(CFStringRef *)output)
+				header.encoding |= SndCtlHALEncodingOutputIsNull;
+
+			output = outputBytes = SndCtlHALCopyUTF8(*(CFStringRef *)output, &header.outputSize);
+		}
+	}
+
+	pthread_mutex_lock(&gHALLock);
+
+	if (gRecordFile) {
+		fwrite(&header, sizeof(header), 1, gRecordFile);
+		fwrite(qualifier, 1, header.qualifierSize, gRecordFile);
+		fwrite(input, 1, header.inputSize, gRecordFile);
+		fwrite(output, 1, header.outputSize, gRecordFile);
+	}
+
+	pthread_mutex_unlock(&gHALLock);
+
+	free(qualifierBytes);
+	free(inputBytes);
+	free(outputBytes);
+}
+
+bool SndCtlHALStartRecording(const char *path, CFErrorRef *error) {
+	SndCtlHALStop();
+
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		if (error)
+			*error = SndCtlErrorCreateWithPOSIXCode(errno, CFSTR("Couldn't create HAL log"));
+
+		return false;
+	}
+
+	fwrite(kSndCtlHALLogMagic, 1, sizeof(kSndCtlHALLogMagic), file);
+	fwrite(&kSndCtlHALLogVersion, sizeof(kSndCtlHALLogVersion), 1, file);
+
+	pthread_mutex_lock(&gHALLock);
+	gRecordFile = file;
+	gBackend = SndCtlHALBackendRecord;
+	pthread_mutex_unlock(&gHALLock);
+
+	return true;
+}
+
+static bool SndCtlHALReplayFail(UInt8 *bytes, SndCtlHALReplayEntry *entries, CFErrorRef *error) {
+	free(bytes);
+	free(entries);
+
+	if (error)
+		*error = SndCtlErrorCreateWithPOSIXCode(EFTYPE, CFSTR("Couldn't read HAL log"));
+
+	return false;
+}
+
+bool SndCtlHALStartReplay(const char *path, double latencyScale, CFErrorRef *error) {
+	SndCtlHALStop();
+
+	FILE *file = fopen(path, "rb");
+
+	if (!file) {
+		if (error)
+			*error = SndCtlErrorCreateWithPOSIXCode(errno, CFSTR("Couldn't open HAL log"));
+
+		return false;
+	}
+
+	fseeko(file, 0, SEEK_END);
+	size_t length = (size_t)ftello(file);
+	fseeko(file, 0, SEEK_SET);
+
+	UInt8 *bytes = malloc(length > 0 ? length : 1);
+	size_t readLength = fread(bytes, 1, length, file);
+	fclose(file);
+
+	UInt32 version;
+
+	if (readLength != length || length < sizeof(kSndCtlHALLogMagic) + sizeof(version) || memcmp(bytes, kSndCtlHALLogMagic, sizeof(kSndCtlHALLogMagic)) != 0)
+		return SndCtlHALReplayFail(bytes, NULL, error);
+
+	memcpy(&version, bytes + sizeof(kSndCtlHALLogMagic), sizeof(version));
+
+	if (version < kSndCtlHALLogOldestVersion || version > kSndCtlHALLogVersion)
+		return SndCtlHALReplayFail(bytes, NULL, error);
+
+	size_t capacity = 64;
+	size_t count = 0;
+	SndCtlHALReplayEntry *entries = malloc(capacity * sizeof(SndCtlHALReplayEntry));
+	size_t offset = sizeof(kSndCtlHALLogMagic) + sizeof(version);
+
+	while (offset < length) {
+		if (length - offset < sizeof(SndCtlHALRecordHeader))
+			return SndCtlHALReplayFail(bytes, entries, error);
+
+		// Records aren't padded, so copy the header out rather than pointing into the log.
+		SndCtlHALRecordHeader header;
+		memcpy(&header, bytes + offset, sizeof(header));
+		size_t payloadLength = (size_t)header.qualifierSize + header.inputSize + header.outputSize;
+		offset += sizeof(header);
+
+		if (length - offset < payloadLength)
+			return SndCtlHALReplayFail(bytes, entries, error);
+
+		if (count == capacity) {
+			capacity *= 2;
+			entries = realloc(entries, capacity * sizeof(SndCtlHALReplayEntry));
+		}
+
+		SndCtlHALReplayEntry *entry = &entries[count++];
+		entry->header = header;
+		entry->qualifier = bytes + offset;
+		entry->input = entry->qualifier + header.qualifierSize;
+		entry->output = entry->input + header.inputSize;
+		entry->used = false;
+
+		offset += payloadLength;
+	}
+
+	pthread_mutex_lock(&gHALLock);
+	gReplayBytes = bytes;
+	gReplayEntries = entries;
+	gReplayCount = count;
+	gReplayFirstUnused = 0;
+	gReplayLatencyScale = latencyScale;
+	gBackend = SndCtlHALBackendReplay;
+	pthread_mutex_unlock(&gHALLock);
+
+	return true;
+}
+
+// Finds and consumes the first unused record matching a call. The record's storage lives
+// until SndCtlHALStop(), so the returned entry can be used after the lock is dropped.
+static const SndCtlHALReplayEntry *SndCtlHALReplayTake(SndCtlHALOperation operation, AudioObjectID objectid, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 inputSize, const void *input) {
+	UInt8 *qualifierBytes = NULL;
+	UInt8 *inputBytes = NULL;
+
+	if (qualifierSize && SndCtlHALQualifierIsString(address->mSelector))
+		qualifier = qualifierBytes = SndCtlHALCopyUTF8(*(CFStringRef *)qualifier, &qualifierSize);
+
+	UInt8 inputEncoding = 0;
+
+	if (inputSize == sizeof(CFStringRef) && SndCtlHALPropertyIsString(address->mSelector)) {
+		if (!*(CFStringRef *)input)
+			inputEncoding = SndCtlHALEncodingInputIsNull;
+
+		input = inputBytes = SndCtlHALCopyUTF8(*(CFStringRef *)input, &inputSize);
+	}
+
+	const SndCtlHALReplayEntry *match = NULL;
+
+	pthread_mutex_lock(&gHALLock);
+
+	for (size_t i = gReplayFirstUnused; i < gReplayCount; ++i) {
+		SndCtlHALReplayEntry *entry = &gReplayEntries[i];
+		const SndCtlHALRecordHeader *header = &entry->header;
+
+		if (entry->used
+			|| header->operation != operation
+			|| header->objectid != objectid
+			|| header->address.mSelector != address->mSelector
+			|| header->address.mScope != address->mScope
+			|| header->address.mElement != address->mElement
+			|| header->qualifierSize != qualifierSize
+			|| (qualifierSize && memcmp(entry->qualifier, qualifier, qualifierSize) != 0))
+			continue;
+
+		if (operation == SndCtlHALOperationSetPropertyData && (header->inputSize != inputSize || memcmp(entry->input, input, inputSize) != 0 || (header->encoding & SndCtlHALEncodingInputIsNull) != inputEncoding))
+			continue;
+
+		entry->used = true;
+		match = entry;
+		break;
+	}
+
+	while (gReplayFirstUnused < gReplayCount && gReplayEntries[gReplayFirstUnused].used)
+		++gReplayFirstUnused;
+
+	double latencyScale = gReplayLatencyScale;
+	UInt64 latency = gReplayLatency;
+
+	pthread_mutex_unlock(&gHALLock);
+
+	free(qualifierBytes);
+	free(inputBytes);
+
+	if (match && (latencyScale > 0.0 || latency)) {
+		UInt64 delay = (UInt64)(match->header.duration * latencyScale) + latency;
+		struct timespec interval = { (time_t)(delay / 1000000000), (long)(delay % 1000000000) };
+		nanosleep(&interval, NULL);
+	}
+
+	return match;
+}
+
+void SndCtlHALSetReplayLatency(UInt64 nanoseconds) {
+	pthread_mutex_lock(&gHALLock);
+	gReplayLatency = nanoseconds;
+	pthread_mutex_unlock(&gHALLock);
+}
+
+void SndCtlHALStop(void) {
+	pthread_mutex_lock(&gHALLock);
+
+	if (gRecordFile) {
+		fclose(gRecordFile);
+		gRecordFile = NULL;
+	}
+
+	free(gReplayEntries);
+	free(gReplayBytes);
+	gReplayEntries = NULL;
+	gReplayBytes = NULL;
+	gReplayCount = 0;
+	gReplayFirstUnused = 0;
+
+	gBackend = SndCtlHALBackendLive;
+
+	pthread_mutex_unlock(&gHALLock);
+}
+
+SndCtlHALBackend SndCtlHALGetBackend(void) {
+	pthread_mutex_lock(&gHALLock);
+	SndCtlHALBackend backend = gBackend;
+	pthread_mutex_unlock(&gHALLock);
+
+	return backend;
+}
+
+static OSStatus SndCtlHALDirectGetPropertyDataSize(AudioObjectID objectid, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *outSize) {
+	switch (SndCtlHALGetBackend()) {
+		case SndCtlHALBackendLive:
+			return AudioObjectGetPropertyDataSize(objectid, address, qualifierSize, qualifier, outSize);
+		case SndCtlHALBackendRecord: {
+			UInt64 start = SndCtlHALNow();
+			OSStatus result = AudioObjectGetPropertyDataSize(objectid, address, qualifierSize, qualifier, outSize);
+
+			SndCtlHALRecordHeader header = {
+				.duration = SndCtlHALNow() - start,
+				.objectid = objectid,
+				.address = *address,
+				.status = result,
+				.qualifierSize = qualifierSize,
+				.resultSize = result == kAudioHardwareNoError ? *outSize : 0,
+				.operation = SndCtlHALOperationGetPropertyDataSize,
+			};
+			SndCtlHALRecord(header, qualifier, NULL, NULL);
+
+			return result;
+		}
+		case SndCtlHALBackendReplay: {
+			const SndCtlHALReplayEntry *entry = SndCtlHALReplayTake(SndCtlHALOperationGetPropertyDataSize, objectid, address, qualifierSize, qualifier, 0, NULL);
+
+			if (!entry)
+				return kAudioHardwareUnspecifiedError;
+
+			if (entry->header.status == kAudioHardwareNoError)
+				*outSize = entry->header.resultSize;
+
+			return entry->header.status;
+		}
+	}
+
+	return kAudioHardwareUnspecifiedError;
+}
+
+static OSStatus SndCtlHALDirectGetPropertyData(AudioObjectID objectid, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *ioSize, void *outData) {
+	switch (SndCtlHALGetBackend()) {
+		case SndCtlHALBackendLive:
+			return AudioObjectGetPropertyData(objectid, address, qualifierSize, qualifier, ioSize, outData);
+		case SndCtlHALBackendRecord: {
+			UInt64 start = SndCtlHALNow();
+			OSStatus result = AudioObjectGetPropertyData(objectid, address, qualifierSize, qualifier, ioSize, outData);
+
+			SndCtlHALRecordHeader header = {
+				.duration = SndCtlHALNow() - start,
+				.objectid = objectid,
+				.address = *address,
+				.status = result,
+				.qualifierSize = qualifierSize,
+				.outputSize = result == kAudioHardwareNoError ? *ioSize : 0,
+				.resultSize = result == kAudioHardwareNoError ? *ioSize : 0,
+				.operation = SndCtlHALOperationGetPropertyData,
+			};
+			SndCtlHALRecord(header, qualifier, NULL, outData);
+
+			return result;
+		}
+		case SndCtlHALBackendReplay: {
+			const SndCtlHALReplayEntry *entry = SndCtlHALReplayTake(SndCtlHALOperationGetPropertyData, objectid, address, qualifierSize, qualifier, 0, NULL);
+
+			if (!entry)
+				return kAudioHardwareUnspecifiedError;
+
+			const SndCtlHALRecordHeader *header = &entry->header;
+
+			if (header->status != kAudioHardwareNoError)
+				return header->status;
+
+			if (header->encoding & SndCtlHALEncodingDataIsString) {
+				if (*ioSize < sizeof(CFStringRef))
+					return kAudioHardwareBadPropertySizeError;
+
+				if (header->encoding & SndCtlHALEncodingOutputIsNull)
+					*(CFStringRef *)outData = NULL;
+				else
+					*(CFStringRef *)outData = CFStringCreateWithBytes(kCFAllocatorDefault, entry->output, header->outputSize, kCFStringEncodingUTF8, false);
+
+				*ioSize = sizeof(CFStringRef);
+			} else {
+				UInt32 size = header->outputSize < *ioSize ? header->outputSize : *ioSize;
+				memcpy(outData, entry->output, size);
+				*ioSize = size;
+			}
+
+			return kAudioHardwareNoError;
+		}
+	}
+
+	return kAudioHardwareUnspecifiedError;
+}
+
+static OSStatus SndCtlHALDirectSetPropertyData(AudioObjectID objectid, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 size, const void *data) {
+	switch (SndCtlHALGetBackend()) {
+		case SndCtlHALBackendLive:
+			return AudioObjectSetPropertyData(objectid, address, qualifierSize, qualifier, size, data);
+		case SndCtlHALBackendRecord: {
+			UInt64 start = SndCtlHALNow();
+			OSStatus result = AudioObjectSetPropertyData(objectid, address, qualifierSize, qualifier, size, data);
+
+			SndCtlHALRecordHeader header = {
+				.duration = SndCtlHALNow() - start,
+				.objectid = objectid,
+				.address = *address,
+				.status = result,
+				.qualifierSize = qualifierSize,
+				.inputSize = size,
+				.operation = SndCtlHALOperationSetPropertyData,
+			};
+			SndCtlHALRecord(header, qualifier, data, NULL);
+
+			return result;
+		}
+		case SndCtlHALBackendReplay: {
+			const SndCtlHALReplayEntry *entry = SndCtlHALReplayTake(SndCtlHALOperationSetPropertyData, objectid, address, qualifierSize, qualifier, size, data);
+
+			if (!entry)
+				return kAudioHardwareUnspecifiedError;
+
+			return entry->header.status;
+		}
+	}
+
+	return kAudioHardwareUnspecifiedError;
+}
+
+static Boolean SndCtlHALDirectHasProperty(AudioObjectID objectid, const AudioObjectPropertyAddress *address) {
+	switch (SndCtlHALGetBackend()) {
+		case SndCtlHALBackendLive:
+			return AudioObjectHasProperty(objectid, address);
+		case SndCtlHALBackendRecord: {
+			UInt64 start = SndCtlHALNow();
+			Boolean result = AudioObjectHasProperty(objectid, address);
+
+			SndCtlHALRecordHeader header = {
+				.duration = SndCtlHALNow() - start,
+				.objectid = objectid,
+				.address = *address,
+				.resultSize = result,
+				.operation = SndCtlHALOperationHasProperty,
+			};
+			SndCtlHALRecord(header, NULL, NULL, NULL);
+
+			return result;
+		}
+		case SndCtlHALBackendReplay: {
+			const SndCtlHALReplayEntry *entry = SndCtlHALReplayTake(SndCtlHALOperationHasProperty, objectid, address, 0, NULL, 0, NULL);
+
+			return entry ? (Boolean)entry->header.resultSize : false;
+		}
+	}
+
+	return false;
+}
+
+typedef struct {
+	SndCtlHALOperation operation;
+	AudioObjectID objectid;
+	AudioObjectPropertyAddress address;
+	UInt32 qualifierSize;
+	void *qualifier;
+	UInt32 size;
+	void *data;
+
+	OSStatus result;
+	Boolean hasProperty;
+
+	dispatch_semaphore_t done;
+	/// Whether the caller gave up waiting; the worker then cleans up.
+	bool abandoned;
+} SndCtlHALTimedCall;
+
+static void SndCtlHALTimedCallFree(SndCtlHALTimedCall *call) {
+	if (call->qualifierSize && SndCtlHALQualifierIsString(call->address.mSelector))
+		CFRelease(*(CFStringRef *)call->qualifier);
+
+	// Size queries and HasProperty only hand back a size or flag, never a string.
+	bool carriesString = call->operation == SndCtlHALOperationGetPropertyData || call->operation == SndCtlHALOperationSetPropertyData;
+
+	if (carriesString && SndCtlHALPropertyIsString(call->address.mSelector) && call->size == sizeof(CFStringRef)) {
+		CFStringRef string = *(CFStringRef *)call->data;
+
+		// Set data is retained by the caller's side; get data is only ours if the caller gave up.
+		if (string && (call->operation == SndCtlHALOperationSetPropertyData || (call->abandoned && call->result == kAudioHardwareNoError)))
+			CFRelease(string);
+	}
+
+	dispatch_release(call->done);
+	free(call->qualifier);
+	free(call->data);
+	free(call);
+}
+
+static void SndCtlHALTimedCallPerform(void *context) {
+	SndCtlHALTimedCall *call = context;
+
+	switch (call->operation) {
+		case SndCtlHALOperationGetPropertyDataSize:
+			call->result = SndCtlHALDirectGetPropertyDataSize(call->objectid, &call->address, call->qualifierSize, call->qualifier, &call->size);
+			break;
+		case SndCtlHALOperationGetPropertyData:
+			call->result = SndCtlHALDirectGetPropertyData(call->objectid, &call->address, call->qualifierSize, call->qualifier, &call->size, call->data);
+			break;
+		case SndCtlHALOperationSetPropertyData:
+			call->result = SndCtlHALDirectSetPropertyData(call->objectid, &call->address, call->qualifierSize, call->qualifier, call->size, call->data);
+			break;
+		case SndCtlHALOperationHasProperty:
+			call->hasProperty = SndCtlHALDirectHasProperty(call->objectid, &call->address);
+			break;
+	}
+
+	// Signal under the lock so the waiter either sees the signal or has already given up.
+	pthread_mutex_lock(&gHALLock);
+	bool abandoned = call->abandoned;
+
+	if (!abandoned)
+		dispatch_semaphore_signal(call->done);
+
+	pthread_mutex_unlock(&gHALLock);
+
+	if (abandoned)
+		SndCtlHALTimedCallFree(call);
+}
+
+// Must be called with gHALLock held.
+static bool SndCtlHALObjectIsUnresponsiveLocked(AudioObjectID objectid) {
+	for (size_t i = 0; i < gUnresponsiveCount; ++i) {
+		if (gUnresponsiveObjects[i] == objectid)
+			return true;
+	}
+
+	return false;
+}
+
+// Must be called with gHALLock held.
+static void SndCtlHALMarkUnresponsiveLocked(AudioObjectID objectid) {
+	if (SndCtlHALObjectIsUnresponsiveLocked(objectid))
+		return;
+
+	gUnresponsiveObjects = realloc(gUnresponsiveObjects, (gUnresponsiveCount + 1) * sizeof(AudioObjectID));
+	gUnresponsiveObjects[gUnresponsiveCount++] = objectid;
+}
+
+// Returns how long a call may take, 0 if it shouldn't be attempted at all, or UINT64_MAX if there's no limit.
+static UInt64 SndCtlHALTimeoutForObject(AudioObjectID objectid) {
+	pthread_mutex_lock(&gHALLock);
+
+	UInt64 timeout = gCallTimeout ? gCallTimeout : UINT64_MAX;
+	bool unresponsive = SndCtlHALObjectIsUnresponsiveLocked(objectid);
+
+	if (!unresponsive && gDeadline) {
+		UInt64 now = SndCtlHALNow();
+		UInt64 remaining = gDeadline > now ? gDeadline - now : 0;
+
+		// An object that's only reached after the deadline is left out just like one that hung, so
+		// it's reported the same way.
+		if (remaining == 0) {
+			SndCtlHALMarkUnresponsiveLocked(objectid);
+			unresponsive = true;
+		} else if (remaining < timeout)
+			timeout = remaining;
+	}
+
+	// Every wrapper starts here, so this is where issued calls are counted.
+	if (!unresponsive)
+		++gCallCount;
+
+	pthread_mutex_unlock(&gHALLock);
+
+	return unresponsive ? 0 : timeout;
+}
+
+// Runs a call on a background queue, waiting at most timeout nanoseconds for it. The call owns copies
+// of everything it touches, so a call that's given up on can finish on its own later.
+static OSStatus SndCtlHALPerformWithTimeout(SndCtlHALTimedCall *call, UInt64 timeout) {
+	if (call->qualifierSize && SndCtlHALQualifierIsString(call->address.mSelector))
+		CFRetain(*(CFStringRef *)call->qualifier);
+	if (call->operation == SndCtlHALOperationSetPropertyData && call->size == sizeof(CFStringRef) && SndCtlHALPropertyIsString(call->address.mSelector))
+		CFRetain(*(CFStringRef *)call->data);
+
+	call->done = dispatch_semaphore_create(0);
+	dispatch_async_f(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), call, SndCtlHALTimedCallPerform);
+
+	if (dispatch_semaphore_wait(call->done, dispatch_time(DISPATCH_TIME_NOW, (int64_t)timeout)) == 0)
+		return kAudioHardwareNoError;
+
+	pthread_mutex_lock(&gHALLock);
+
+	// The call may have finished between the timeout and taking the lock.
+	if (dispatch_semaphore_wait(call->done, DISPATCH_TIME_NOW) == 0) {
+		pthread_mutex_unlock(&gHALLock);
+		return kAudioHardwareNoError;
+	}
+
+	call->abandoned = true;
+	SndCtlHALMarkUnresponsiveLocked(call->objectid);
+
+	pthread_mutex_unlock(&gHALLock);
+
+	return kSndCtlHALTimedOutError;
+}
+
+static SndCtlHALTimedCall *SndCtlHALTimedCallCreate(SndCtlHALOperation operation, AudioObjectID objectid, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 size, const void *data) {
+	SndCtlHALTimedCall *call = calloc(1, sizeof(SndCtlHALTimedCall));
+	call->operation = operation;
+	call->objectid = objectid;
+	call->address = *address;
+	call->qualifierSize = qualifierSize;
+	call->qualifier = malloc(qualifierSize > 0 ? qualifierSize : 1);
+	call->size = size;
+	call->data = calloc(1, size > 0 ? size : 1);
+
+	if (qualifierSize)
+		memcpy(call->qualifier, qualifier, qualifierSize);
+	if (data && size)
+		memcpy(call->data, data, size);
+
+	return call;
+}
+
+void SndCtlHALSetCallTimeout(UInt64 nanoseconds) {
+	pthread_mutex_lock(&gHALLock);
+	gCallTimeout = nanoseconds;
+	pthread_mutex_unlock(&gHALLock);
+}
+
+void SndCtlHALSetDeadline(UInt64 nanoseconds) {
+	pthread_mutex_lock(&gHALLock);
+	gDeadline = nanoseconds ? SndCtlHALNow() + nanoseconds : 0;
+	pthread_mutex_unlock(&gHALLock);
+}
+
+bool SndCtlHALObjectIsUnresponsive(AudioObjectID objectid) {
+	pthread_mutex_lock(&gHALLock);
+	bool unresponsive = SndCtlHALObjectIsUnresponsiveLocked(objectid);
+	pthread_mutex_unlock(&gHALLock);
+
+	return unresponsive;
+}
+
+UInt64 SndCtlHALGetCallCount(void) {
+	pthread_mutex_lock(&gHALLock);
+	UInt64 count = gCallCount;
+	pthread_mutex_unlock(&gHALLock);
+
+	return count;
+}
+
+bool SndCtlHALAnyObjectUnresponsive(void) {
+	pthread_mutex_lock(&gHALLock);
+	bool unresponsive = gUnresponsiveCount > 0;
+	pthread_mutex_unlock(&gHALLock);
+
+	return unresponsive;
+}
+
+OSStatus SndCtlHALGetPropertyDataSize(AudioObjectID objectid, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *outSize) {
+	UInt64 timeout = SndCtlHALTimeoutForObject(objectid);
+
+	if (timeout == UINT64_MAX)
+		return SndCtlHALDirectGetPropertyDataSize(objectid, address, qualifierSize, qualifier, outSize);
+	if (timeout == 0)
+		return kSndCtlHALTimedOutError;
+
+	SndCtlHALTimedCall *call = SndCtlHALTimedCallCreate(SndCtlHALOperationGetPropertyDataSize, objectid, address, qualifierSize, qualifier, 0, NULL);
+	OSStatus result = SndCtlHALPerformWithTimeout(call, timeout);
+
+	if (result != kAudioHardwareNoError)
+		return result;
+
+	result = call->result;
+	if (result == kAudioHardwareNoError)
+		*outSize = call->size;
+
+	SndCtlHALTimedCallFree(call);
+
+	return result;
+}
+
+OSStatus SndCtlHALGetPropertyData(AudioObjectID objectid, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *ioSize, void *outData) {
+	UInt64 timeout = SndCtlHALTimeoutForObject(objectid);
+
+	if (timeout == UINT64_MAX)
+		return SndCtlHALDirectGetPropertyData(objectid, address, qualifierSize, qualifier, ioSize, outData);
+	if (timeout == 0)
+		return kSndCtlHALTimedOutError;
+
+	SndCtlHALTimedCall *call = SndCtlHALTimedCallCreate(SndCtlHALOperationGetPropertyData, objectid, address, qualifierSize, qualifier, *ioSize, NULL);
+	OSStatus result = SndCtlHALPerformWithTimeout(call, timeout);
+
+	if (result != kAudioHardwareNoError)
+		return result;
+
+	result = call->result;
+	if (result == kAudioHardwareNoError) {
+		memcpy(outData, call->data, call->size);
+		*ioSize = call->size;
+	}
+
+	// The caller now owns any returned string.
+	call->size = 0;
+	SndCtlHALTimedCallFree(call);
+
+	return result;
+}
+
+OSStatus SndCtlHALSetPropertyData(AudioObjectID objectid, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 size, const void *data) {
+	UInt64 timeout = SndCtlHALTimeoutForObject(objectid);
+
+	if (timeout == UINT64_MAX)
+		return SndCtlHALDirectSetPropertyData(objectid, address, qualifierSize, qualifier, size, data);
+	if (timeout == 0)
+		return kSndCtlHALTimedOutError;
+
+	SndCtlHALTimedCall *call = SndCtlHALTimedCallCreate(SndCtlHALOperationSetPropertyData, objectid, address, qualifierSize, qualifier, size, data);
+	OSStatus result = SndCtlHALPerformWithTimeout(call, timeout);
+
+	if (result != kAudioHardwareNoError)
+		return result;
+
+	result = call->result;
+	SndCtlHALTimedCallFree(call);
+
+	return result;
+}
+
+Boolean SndCtlHALHasProperty(AudioObjectID objectid, const AudioObjectPropertyAddress *address) {
+	UInt64 timeout = SndCtlHALTimeoutForObject(objectid);
+
+	if (timeout == UINT64_MAX)
+		return SndCtlHALDirectHasProperty(objectid, address);
+	if (timeout == 0)
+		return false;
+
+	SndCtlHALTimedCall *call = SndCtlHALTimedCallCreate(SndCtlHALOperationHasProperty, objectid, address, 0, NULL, 0, NULL);
+
+	if (SndCtlHALPerformWithTimeout(call, timeout) != kAudioHardwareNoError)
+		return false;
+
+	Boolean hasProperty = call->hasProperty;
+	SndCtlHALTimedCallFree(call);
+
+	return hasProperty;
+}
+
+OSStatus SndCtlHALAddPropertyListener(AudioObjectID objectid, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData) {
+	// A recording has nothing to say about when properties change.
+	if (SndCtlHALGetBackend() == SndCtlHALBackendReplay)
+		return kAudioHardwareNoError;
+
+	return AudioObjectAddPropertyListener(objectid, address, listener, clientData);
+}
+
+OSStatus SndCtlHALRemovePropertyListener(AudioObjectID objectid, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData) {
+	if (SndCtlHALGetBackend() == SndCtlHALBackendReplay)
+		return kAudioHardwareNoError;
+
+	return AudioObjectRemovePropertyListener(objectid, address, listener, clientData);
+}
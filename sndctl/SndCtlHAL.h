@@ -0,0 +1,138 @@
+//
+//  SndCtlHAL.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlHAL_h
+#define SndCtlHAL_h
+
+#include <stdio.h>
+#include <AudioToolbox/AudioToolbox.h>
+
+/**
+ Thin layer over the \c AudioObject property calls.
+
+ All of sndctl's HAL traffic goes through these functions so that a session can be
+ recorded to a file and later replayed without the original hardware.
+
+ The log is a 4-byte magic (\c "SCHL"\n), a \c UInt32 version, then one record per call:
+ a fixed-size header (operation, object ID, property address, status, sizes and the call's
+ duration in nanoseconds), followed by the qualifier, the input data and the output data.
+ Properties whose value is a \c CFStringRef are stored as UTF-8, with a \c NULL string flagged
+ in the header so that it replays as \c NULL rather than as an empty string.
+ */
+
+/// The backend that services HAL calls.
+typedef enum {
+	/// Calls go straight to the HAL.
+	SndCtlHALBackendLive,
+	/// Calls go to the HAL and are appended to a log.
+	SndCtlHALBackendRecord,
+	/// Calls are answered from a previously recorded log.
+	SndCtlHALBackendReplay,
+} SndCtlHALBackend;
+
+/**
+ Get the active backend.
+ */
+SndCtlHALBackend SndCtlHALGetBackend(void);
+
+/**
+ Start recording HAL calls to a file.
+ @param path	The path of the log to create. An existing file is truncated.
+ @param error	An error on failure.
+ @return Whether the log could be opened.
+ */
+bool SndCtlHALStartRecording(const char *path, CFErrorRef *error);
+
+/**
+ Answer HAL calls from a recorded log instead of the HAL.
+ @param path			The path of a log written by \c SndCtlHALStartRecording()\n.
+ @param latencyScale	Multiplier applied to each call's recorded duration before it's
+ 						returned; \c 0.0 returns immediately, \c 1.0 reproduces the original timing.
+ @param error			An error on failure.
+ @return Whether the log could be loaded.
+ @discussion Each call is answered by the first unused record with the same operation,
+ 	object, address, qualifier and (for sets) data, so sessions replay correctly even if
+ 	calls are issued in a different order. Calls with no matching record fail with
+ 	\c kAudioHardwareUnspecifiedError\n.
+ */
+bool SndCtlHALStartReplay(const char *path, double latencyScale, CFErrorRef *error);
+
+/**
+ Add a fixed delay to every replayed call, on top of its scaled recorded duration.
+ @param nanoseconds	The delay, or \c 0 for none.
+ @discussion Simulates a slow HAL more evenly than scaling, which also scales one-off outliers
+ 	like a device's first call.
+ */
+void SndCtlHALSetReplayLatency(UInt64 nanoseconds);
+
+/**
+ Flush and close any log and go back to the live backend.
+ */
+void SndCtlHALStop(void);
+
+/// Returned by the wrappers when a call misses its deadline, or is made on an object that missed one earlier.
+enum {
+	kSndCtlHALTimedOutError = 'tmou'
+};
+
+/**
+ Limit how long any single HAL call may take.
+ @param nanoseconds	The limit, or \c 0 for none.
+ @discussion Calls that miss the limit fail with \c kSndCtlHALTimedOutError and their object is
+ 	marked unresponsive: later calls on it fail immediately, so one hung device costs at most one
+ 	timeout. The abandoned call is left to finish in the background.
+ */
+void SndCtlHALSetCallTimeout(UInt64 nanoseconds);
+
+/**
+ Limit how long all remaining HAL calls may take in total.
+ @param nanoseconds	The time from now by which all calls must have finished, or \c 0 for no deadline.
+ @discussion Calls still running at the deadline are handled as for \c SndCtlHALSetCallTimeout()\n.
+ 	Calls made after it fail immediately, and their object is marked unresponsive too, so anything
+ 	skipped because of the deadline is reported rather than silently left out.
+ */
+void SndCtlHALSetDeadline(UInt64 nanoseconds);
+
+/**
+ Returns whether an object has missed a call timeout or the deadline.
+ */
+bool SndCtlHALObjectIsUnresponsive(AudioObjectID objectid);
+
+/**
+ Returns whether any object has missed a call timeout or the deadline.
+ */
+bool SndCtlHALAnyObjectUnresponsive(void);
+
+/**
+ Returns the number of HAL calls issued so far.
+ @discussion Calls that fail immediately because their object is unresponsive aren't counted.
+ */
+UInt64 SndCtlHALGetCallCount(void);
+
+/// Wraps \c AudioObjectGetPropertyDataSize()\n.
+OSStatus SndCtlHALGetPropertyDataSize(AudioObjectID objectid, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *outSize);
+
+/// Wraps \c AudioObjectGetPropertyData()\n.
+OSStatus SndCtlHALGetPropertyData(AudioObjectID objectid, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *ioSize, void *outData);
+
+/// Wraps \c AudioObjectSetPropertyData()\n.
+OSStatus SndCtlHALSetPropertyData(AudioObjectID objectid, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 size, const void *data);
+
+/// Wraps \c AudioObjectHasProperty()\n.
+Boolean SndCtlHALHasProperty(AudioObjectID objectid, const AudioObjectPropertyAddress *address);
+
+/**
+ Wraps \c AudioObjectAddPropertyListener()\n.
+ @discussion Notifications aren't recorded. While replaying, listeners are accepted but never called.
+ */
+OSStatus SndCtlHALAddPropertyListener(AudioObjectID objectid, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData);
+
+/// Wraps \c AudioObjectRemovePropertyListener()\n.
+OSStatus SndCtlHALRemovePropertyListener(AudioObjectID objectid, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData);
+
+#endif /* SndCtlHAL_h */
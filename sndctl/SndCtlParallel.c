@@ -0,0 +1,130 @@
+//
+//  SndCtlParallel.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlParallel.h"
+#include <pthread.h>
+
+static unsigned gMaxThreads = kSndCtlParallelMaxThreads;
+
+typedef struct SndCtlParallelJob {
+	size_t count;
+	void *context;
+	void (*work)(void *context, size_t index);
+	size_t nextIndex;
+	size_t doneCount;
+	/// How many pool threads may work on this job alongside the caller.
+	unsigned helperLimit;
+	unsigned helperCount;
+	struct SndCtlParallelJob *next;
+} SndCtlParallelJob;
+
+// Guards the job list, every job's counters, and the pool size.
+static pthread_mutex_t gPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gWorkAvailable = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t gWorkDone = PTHREAD_COND_INITIALIZER;
+/// Jobs that are still running; each lives on its caller's stack until it's done.
+static SndCtlParallelJob *gJobs = NULL;
+/// Pool threads are started as they're first needed and then kept for later calls.
+static unsigned gPoolThreadCount = 0;
+
+// Must be called with gPoolLock held. Takes indexes from a job until there are none left,
+// dropping the lock around each call.
+static void SndCtlParallelRunLocked(SndCtlParallelJob *job) {
+	while (job->nextIndex < job->count) {
+		size_t i = job->nextIndex++;
+
+		pthread_mutex_unlock(&gPoolLock);
+		job->work(job->context, i);
+		pthread_mutex_lock(&gPoolLock);
+
+		if (++job->doneCount == job->count)
+			pthread_cond_broadcast(&gWorkDone);
+	}
+}
+
+// Must be called with gPoolLock held.
+static SndCtlParallelJob *SndCtlParallelJobNeedingHelpLocked(void) {
+	for (SndCtlParallelJob *job = gJobs; job; job = job->next) {
+		if (job->nextIndex < job->count && job->helperCount < job->helperLimit)
+			return job;
+	}
+
+	return NULL;
+}
+
+static void *SndCtlParallelPoolThread(void *unused) {
+	pthread_mutex_lock(&gPoolLock);
+
+	while (true) {
+		SndCtlParallelJob *job = SndCtlParallelJobNeedingHelpLocked();
+
+		if (!job) {
+			pthread_cond_wait(&gWorkAvailable, &gPoolLock);
+			continue;
+		}
+
+		// The lock is held from the job's last call until it's left, so its caller can't return first.
+		++job->helperCount;
+		SndCtlParallelRunLocked(job);
+		--job->helperCount;
+	}
+
+	return NULL;
+}
+
+void SndCtlParallelFor(size_t count, void *context, void (*work)(void *context, size_t index)) {
+	if (count == 0)
+		return;
+
+	unsigned maxThreads = __atomic_load_n(&gMaxThreads, __ATOMIC_RELAXED);
+	SndCtlParallelJob job = {
+		.count = count,
+		.context = context,
+		.work = work,
+		.helperLimit = (count < maxThreads ? (unsigned)count : maxThreads) - 1,
+	};
+
+	pthread_mutex_lock(&gPoolLock);
+
+	if (job.helperLimit > 0) {
+		while (gPoolThreadCount < job.helperLimit) {
+			pthread_t thread;
+
+			if (pthread_create(&thread, NULL, SndCtlParallelPoolThread, NULL) != 0)
+				break;
+
+			pthread_detach(thread);
+			++gPoolThreadCount;
+		}
+
+		job.next = gJobs;
+		gJobs = &job;
+		pthread_cond_broadcast(&gWorkAvailable);
+	}
+
+	SndCtlParallelRunLocked(&job);
+
+	while (job.doneCount < job.count)
+		pthread_cond_wait(&gWorkDone, &gPoolLock);
+
+	for (SndCtlParallelJob **link = &gJobs; *link; link = &(*link)->next) {
+		if (*link == &job) {
+			*link = job.next;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&gPoolLock);
+}
+
+void SndCtlParallelSetMaxThreads(unsigned threads) {
+	if (threads == 0 || threads > kSndCtlParallelMaxThreads)
+		threads = kSndCtlParallelMaxThreads;
+
+	__atomic_store_n(&gMaxThreads, threads, __ATOMIC_RELAXED);
+}
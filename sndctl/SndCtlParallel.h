@@ -0,0 +1,38 @@
+//
+//  SndCtlParallel.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlParallel_h
+#define SndCtlParallel_h
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/// The most threads \c SndCtlParallelFor() uses, counting the calling thread.
+#define kSndCtlParallelMaxThreads 16
+
+/**
+ Call a function for every index from \c 0 to \c count \c - \c 1\n, side by side on a small pool of threads.
+ @param count	The number of indexes.
+ @param context	Passed to \c work\n.
+ @param work	Called once per index, concurrently and in no particular order.
+ @discussion Meant for work that's mostly waiting on the HAL, so unlike \c dispatch_apply_f() it
+ 	uses more threads than there are cores. The pool's threads are started the first time they're
+ 	needed and kept for later calls, and concurrent calls share them. The calling thread takes a
+ 	share of the work, and this returns once every call has. If threads can't be started, the
+ 	calling thread does it all.
+ */
+void SndCtlParallelFor(size_t count, void *context, void (*work)(void *context, size_t index));
+
+/**
+ Limit how many threads \c SndCtlParallelFor() uses, counting the calling thread.
+ @param threads	The limit, up to \c kSndCtlParallelMaxThreads\n. \c 1 does all the work on the
+ 				calling thread; \c 0 restores the default.
+ */
+void SndCtlParallelSetMaxThreads(unsigned threads);
+
+#endif /* SndCtlParallel_h */
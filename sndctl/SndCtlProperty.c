@@ -0,0 +1,572 @@
+//
+//  SndCtlProperty.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlProperty.h"
+#include "SndCtlError.h"
+#include "SndCtlHAL.h"
+#include "SndCtlParallel.h"
+#include <ctype.h>
+#include <stddef.h>
+#include <xlocale.h>
+
+static const SndCtlPropertyDescriptor kSndCtlPropertyDescriptors[] = {
+	// Any object
+	{ "name",				kAudioObjectPropertyName,							SndCtlPropertyTypeString,			kAudioObjectPropertyScopeGlobal },
+	{ "manufacturer",		kAudioObjectPropertyManufacturer,					SndCtlPropertyTypeString,			kAudioObjectPropertyScopeGlobal },
+	{ "modelname",			kAudioObjectPropertyModelName,						SndCtlPropertyTypeString,			kAudioObjectPropertyScopeGlobal },
+	{ "elementname",		kAudioObjectPropertyElementName,					SndCtlPropertyTypeString,			kAudioObjectPropertyScopeGlobal },
+	{ "serialnumber",		kAudioObjectPropertySerialNumber,					SndCtlPropertyTypeString,			kAudioObjectPropertyScopeGlobal },
+	{ "firmwareversion",	kAudioObjectPropertyFirmwareVersion,				SndCtlPropertyTypeString,			kAudioObjectPropertyScopeGlobal },
+	{ "creator",			kAudioObjectPropertyCreator,						SndCtlPropertyTypeString,			kAudioObjectPropertyScopeGlobal },
+	{ "class",				kAudioObjectPropertyClass,							SndCtlPropertyTypeFourCharCode,		kAudioObjectPropertyScopeGlobal },
+	{ "baseclass",			kAudioObjectPropertyBaseClass,						SndCtlPropertyTypeFourCharCode,		kAudioObjectPropertyScopeGlobal },
+	{ "owner",				kAudioObjectPropertyOwner,							SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "ownedobjects",		kAudioObjectPropertyOwnedObjects,					SndCtlPropertyTypeUInt32List,		kAudioObjectPropertyScopeGlobal },
+	{ "identify",			kAudioObjectPropertyIdentify,						SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+
+	// The system object
+	{ "devices",			kAudioHardwarePropertyDevices,						SndCtlPropertyTypeUInt32List,		kAudioObjectPropertyScopeGlobal },
+	{ "defaultoutput",		kAudioHardwarePropertyDefaultOutputDevice,			SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "defaultinput",		kAudioHardwarePropertyDefaultInputDevice,			SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "defaultsystemoutput", kAudioHardwarePropertyDefaultSystemOutputDevice,	SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "plugins",			kAudioHardwarePropertyPlugInList,					SndCtlPropertyTypeUInt32List,		kAudioObjectPropertyScopeGlobal },
+	{ "boxes",				kAudioHardwarePropertyBoxList,						SndCtlPropertyTypeUInt32List,		kAudioObjectPropertyScopeGlobal },
+	{ "clockdevices",		kAudioHardwarePropertyClockDeviceList,				SndCtlPropertyTypeUInt32List,		kAudioObjectPropertyScopeGlobal },
+	{ "mixstereotomono",	kAudioHardwarePropertyMixStereoToMono,				SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "sleepingallowed",	kAudioHardwarePropertySleepingIsAllowed,			SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "unloadingallowed",	kAudioHardwarePropertyUnloadingIsAllowed,			SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "hogmodeallowed",		kAudioHardwarePropertyHogModeIsAllowed,				SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+
+	// Devices
+	{ "uid",				kAudioDevicePropertyDeviceUID,						SndCtlPropertyTypeString,			kAudioObjectPropertyScopeGlobal },
+	{ "modeluid",			kAudioDevicePropertyModelUID,						SndCtlPropertyTypeString,			kAudioObjectPropertyScopeGlobal },
+	{ "transport",			kAudioDevicePropertyTransportType,					SndCtlPropertyTypeFourCharCode,		kAudioObjectPropertyScopeGlobal },
+	{ "relateddevices",		kAudioDevicePropertyRelatedDevices,					SndCtlPropertyTypeUInt32List,		kAudioObjectPropertyScopeGlobal },
+	{ "clockdomain",		kAudioDevicePropertyClockDomain,					SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "alive",				kAudioDevicePropertyDeviceIsAlive,					SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "running",			kAudioDevicePropertyDeviceIsRunning,				SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "runningsomewhere",	kAudioDevicePropertyDeviceIsRunningSomewhere,		SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "canbedefault",		kAudioDevicePropertyDeviceCanBeDefaultDevice,		SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+	{ "canbesystemdefault",	kAudioDevicePropertyDeviceCanBeDefaultSystemDevice,	SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+	{ "latency",			kAudioDevicePropertyLatency,						SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+	{ "safetyoffset",		kAudioDevicePropertySafetyOffset,					SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+	{ "streams",			kAudioDevicePropertyStreams,						SndCtlPropertyTypeUInt32List,		kAudioObjectPropertyScopeOutput },
+	{ "controls",			kAudioDevicePropertyControlList,					SndCtlPropertyTypeUInt32List,		kAudioObjectPropertyScopeGlobal },
+	{ "samplerate",			kAudioDevicePropertyNominalSampleRate,				SndCtlPropertyTypeFloat64,			kAudioObjectPropertyScopeGlobal },
+	{ "actualsamplerate",	kAudioDevicePropertyActualSampleRate,				SndCtlPropertyTypeFloat64,			kAudioObjectPropertyScopeGlobal },
+	{ "samplerates",		kAudioDevicePropertyAvailableNominalSampleRates,	SndCtlPropertyTypeValueRangeList,	kAudioObjectPropertyScopeGlobal },
+	{ "buffersize",			kAudioDevicePropertyBufferFrameSize,				SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "buffersizerange",	kAudioDevicePropertyBufferFrameSizeRange,			SndCtlPropertyTypeValueRange,		kAudioObjectPropertyScopeGlobal },
+	{ "variablebuffersize",	kAudioDevicePropertyUsesVariableBufferFrameSizes,	SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "iocycleusage",		kAudioDevicePropertyIOCycleUsage,					SndCtlPropertyTypeFloat32,			kAudioObjectPropertyScopeGlobal },
+	{ "streamconfiguration", kAudioDevicePropertyStreamConfiguration,			SndCtlPropertyTypeBufferList,		kAudioObjectPropertyScopeOutput },
+	{ "preferredstereo",	kAudioDevicePropertyPreferredChannelsForStereo,		SndCtlPropertyTypeUInt32List,		kAudioObjectPropertyScopeOutput },
+	{ "hogmode",			kAudioDevicePropertyHogMode,						SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "hidden",				kAudioDevicePropertyIsHidden,						SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "clockdevice",		kAudioDevicePropertyClockDevice,					SndCtlPropertyTypeString,			kAudioObjectPropertyScopeGlobal },
+	{ "configurationapp",	kAudioDevicePropertyConfigurationApplication,		SndCtlPropertyTypeString,			kAudioObjectPropertyScopeGlobal },
+	{ "jackconnected",		kAudioDevicePropertyJackIsConnected,				SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+
+	// Device controls
+	{ "volume",				kAudioHardwareServiceDeviceProperty_VirtualMainVolume,	SndCtlPropertyTypeFloat32,		kAudioObjectPropertyScopeOutput },
+	{ "balance",			kAudioHardwareServiceDeviceProperty_VirtualMainBalance,	SndCtlPropertyTypeFloat32,		kAudioObjectPropertyScopeOutput },
+	{ "volumescalar",		kAudioDevicePropertyVolumeScalar,					SndCtlPropertyTypeFloat32,			kAudioObjectPropertyScopeOutput },
+	{ "volumedecibels",		kAudioDevicePropertyVolumeDecibels,					SndCtlPropertyTypeFloat32,			kAudioObjectPropertyScopeOutput },
+	{ "volumerange",		kAudioDevicePropertyVolumeRangeDecibels,			SndCtlPropertyTypeValueRange,		kAudioObjectPropertyScopeOutput },
+	{ "mute",				kAudioDevicePropertyMute,							SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+	{ "solo",				kAudioDevicePropertySolo,							SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+	{ "stereopan",			kAudioDevicePropertyStereoPan,						SndCtlPropertyTypeFloat32,			kAudioObjectPropertyScopeOutput },
+	{ "playthru",			kAudioDevicePropertyPlayThru,						SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+	{ "datasource",			kAudioDevicePropertyDataSource,						SndCtlPropertyTypeFourCharCode,		kAudioObjectPropertyScopeOutput },
+	{ "datasources",		kAudioDevicePropertyDataSources,					SndCtlPropertyTypeUInt32List,		kAudioObjectPropertyScopeOutput },
+	{ "clocksource",		kAudioDevicePropertyClockSource,					SndCtlPropertyTypeFourCharCode,		kAudioObjectPropertyScopeGlobal },
+	{ "clocksources",		kAudioDevicePropertyClockSources,					SndCtlPropertyTypeUInt32List,		kAudioObjectPropertyScopeGlobal },
+	{ "subvolume",			kAudioDevicePropertySubVolumeScalar,				SndCtlPropertyTypeFloat32,			kAudioObjectPropertyScopeOutput },
+	{ "submute",			kAudioDevicePropertySubMute,						SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+	{ "linelevel",			kAudioDevicePropertyChannelNominalLineLevel,		SndCtlPropertyTypeFourCharCode,		kAudioObjectPropertyScopeOutput },
+	{ "highpassfilter",		kAudioDevicePropertyHighPassFilterSetting,			SndCtlPropertyTypeFourCharCode,		kAudioObjectPropertyScopeInput },
+	{ "phantompower",		kAudioDevicePropertyPhantomPower,					SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeInput },
+	{ "phaseinvert",		kAudioDevicePropertyPhaseInvert,					SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeInput },
+	{ "talkback",			kAudioDevicePropertyTalkback,						SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+	{ "listenback",			kAudioDevicePropertyListenback,						SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeInput },
+	{ "cliplight",			kAudioDevicePropertyClipLight,						SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+	{ "processmute",		kAudioDevicePropertyProcessMute,					SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeOutput },
+
+	// Streams
+	{ "direction",			kAudioStreamPropertyDirection,						SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "terminaltype",		kAudioStreamPropertyTerminalType,					SndCtlPropertyTypeFourCharCode,		kAudioObjectPropertyScopeGlobal },
+	{ "startingchannel",	kAudioStreamPropertyStartingChannel,				SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "active",				kAudioStreamPropertyIsActive,						SndCtlPropertyTypeUInt32,			kAudioObjectPropertyScopeGlobal },
+	{ "virtualformat",		kAudioStreamPropertyVirtualFormat,					SndCtlPropertyTypeStreamFormat,		kAudioObjectPropertyScopeGlobal },
+	{ "physicalformat",		kAudioStreamPropertyPhysicalFormat,					SndCtlPropertyTypeStreamFormat,		kAudioObjectPropertyScopeGlobal },
+};
+
+static const size_t kSndCtlPropertyDescriptorCount = sizeof(kSndCtlPropertyDescriptors) / sizeof(kSndCtlPropertyDescriptors[0]);
+
+const SndCtlPropertyDescriptor *SndCtlPropertyDescriptors(size_t *count) {
+	*count = kSndCtlPropertyDescriptorCount;
+	return kSndCtlPropertyDescriptors;
+}
+
+const char *SndCtlNameForDeviceProperty(AudioObjectPropertySelector selector) {
+	for (size_t i = 0; i < kSndCtlPropertyDescriptorCount; ++i) {
+		if (kSndCtlPropertyDescriptors[i].selector == selector)
+			return kSndCtlPropertyDescriptors[i].name;
+	}
+
+	return NULL;
+}
+
+const char *SndCtlNameForPropertyType(SndCtlPropertyType type) {
+	switch (type) {
+		case SndCtlPropertyTypeUInt32:
+			return "uint32";
+		case SndCtlPropertyTypeFourCharCode:
+			return "fourcc";
+		case SndCtlPropertyTypeFloat32:
+			return "float32";
+		case SndCtlPropertyTypeFloat64:
+			return "float64";
+		case SndCtlPropertyTypeString:
+			return "string";
+		case SndCtlPropertyTypeUInt32List:
+			return "uint32list";
+		case SndCtlPropertyTypeValueRange:
+			return "range";
+		case SndCtlPropertyTypeValueRangeList:
+			return "rangelist";
+		case SndCtlPropertyTypeBufferList:
+			return "bufferlist";
+		case SndCtlPropertyTypeStreamFormat:
+			return "format";
+		case SndCtlPropertyTypeRaw:
+			break;
+	}
+
+	return "raw";
+}
+
+// Reads a four-character code in single quotes, like 'nsrt'. The quotes are required so that a
+// misspelled four-letter name isn't taken for a code.
+static bool SndCtlPropertyParseFourCharCode(const char *string, UInt32 *code) {
+	if (strlen(string) != 6 || string[0] != '\'' || string[5] != '\'')
+		return false;
+
+	++string;
+	*code = (UInt32)(UInt8)string[0] << 24 | (UInt32)(UInt8)string[1] << 16 | (UInt32)(UInt8)string[2] << 8 | (UInt8)string[3];
+
+	return true;
+}
+
+static bool SndCtlPropertyParseScope(const char *string, AudioObjectPropertyScope *scope) {
+	static const struct {
+		const char *name;
+		AudioObjectPropertyScope scope;
+	} scopes[] = {
+		{ "global",			kAudioObjectPropertyScopeGlobal },
+		{ "input",			kAudioObjectPropertyScopeInput },
+		{ "output",			kAudioObjectPropertyScopeOutput },
+		{ "playthrough",	kAudioObjectPropertyScopePlayThrough },
+	};
+
+	for (size_t i = 0; i < sizeof(scopes) / sizeof(scopes[0]); ++i) {
+		if (strcasecmp(string, scopes[i].name) == 0) {
+			*scope = scopes[i].scope;
+			return true;
+		}
+	}
+
+	return SndCtlPropertyParseFourCharCode(string, scope);
+}
+
+static bool SndCtlPropertyParseElement(const char *string, AudioObjectPropertyElement *element) {
+	if (strcasecmp(string, "main") == 0 || strcasecmp(string, "master") == 0) {
+		*element = kAudioObjectPropertyElementMaster;
+		return true;
+	}
+
+	char *endptr;
+	unsigned long value = strtoul(string, &endptr, 10);
+
+	if (*string == '\0' || *endptr != '\0' || value > UINT32_MAX)
+		return false;
+
+	*element = (AudioObjectPropertyElement)value;
+	return true;
+}
+
+static CFErrorRef SndCtlPropertyErrorCreate(CFStringRef format, const char *string) {
+	CFStringRef description = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, format, string);
+	CFErrorRef error = SndCtlErrorCreate(SndCtlErrorInvalidProperty, description);
+	CFRelease(description);
+
+	return error;
+}
+
+bool SndCtlPropertyRequestParse(const char *string, SndCtlPropertyRequest *request, CFErrorRef *error) {
+	char *copy = strdup(string);
+	char *cursor = copy;
+	char *selectorString = strsep(&cursor, ":");
+	char *scopeString = strsep(&cursor, ":");
+	char *elementString = strsep(&cursor, ":");
+	bool success = false;
+
+	*request = (SndCtlPropertyRequest){
+		.address = { 0, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMaster },
+		.type = SndCtlPropertyTypeRaw,
+		.string = string,
+	};
+
+	size_t i = 0;
+
+	while (i < kSndCtlPropertyDescriptorCount && strcasecmp(kSndCtlPropertyDescriptors[i].name, selectorString) != 0)
+		++i;
+
+	if (i < kSndCtlPropertyDescriptorCount) {
+		request->address.mSelector = kSndCtlPropertyDescriptors[i].selector;
+		request->address.mScope = kSndCtlPropertyDescriptors[i].defaultScope;
+		request->type = kSndCtlPropertyDescriptors[i].type;
+	} else if (SndCtlPropertyParseFourCharCode(selectorString, &request->address.mSelector)) {
+		// Use the table's type for codes it knows, so 'nsrt' decodes the same as samplerate.
+		for (i = 0; i < kSndCtlPropertyDescriptorCount; ++i) {
+			if (kSndCtlPropertyDescriptors[i].selector == request->address.mSelector) {
+				request->address.mScope = kSndCtlPropertyDescriptors[i].defaultScope;
+				request->type = kSndCtlPropertyDescriptors[i].type;
+				break;
+			}
+		}
+	} else {
+		if (error)
+			*error = SndCtlPropertyErrorCreate(CFSTR("Unknown property '%s'. Four-character codes go in single quotes, like 'nsrt'."), selectorString);
+
+		goto done;
+	}
+
+	if (scopeString && !SndCtlPropertyParseScope(scopeString, &request->address.mScope)) {
+		if (error)
+			*error = SndCtlPropertyErrorCreate(CFSTR("Unknown scope '%s'."), scopeString);
+
+		goto done;
+	}
+
+	if (elementString && !SndCtlPropertyParseElement(elementString, &request->address.mElement)) {
+		if (error)
+			*error = SndCtlPropertyErrorCreate(CFSTR("Invalid element '%s'."), elementString);
+
+		goto done;
+	}
+
+	if (cursor) {
+		if (error)
+			*error = SndCtlPropertyErrorCreate(CFSTR("Too many parts in property '%s'."), string);
+
+		goto done;
+	}
+
+	success = true;
+
+done:
+	free(copy);
+	return success;
+}
+
+static void SndCtlPropertyPrintFourCharCode(FILE *stream, UInt32 code) {
+	char chars[4] = { code >> 24, code >> 16, code >> 8, code };
+	bool printable = code != 0;
+
+	for (size_t i = 0; i < 4; ++i)
+		printable = printable && chars[i] >= 0x20 && chars[i] < 0x7f;
+
+	if (printable)
+		fprintf(stream, "'%.4s'", chars);
+	else
+		fprintf(stream, "%u", code);
+}
+
+// Escapes backslashes and control characters so the value stays on one tab-separated line.
+static void SndCtlPropertyPrintEscaped(FILE *stream, const char *string) {
+	for (const char *c = string; *c; ++c) {
+		switch (*c) {
+			case '\\':
+				fputs("\\\\", stream);
+				break;
+			case '\t':
+				fputs("\\t", stream);
+				break;
+			case '\n':
+				fputs("\\n", stream);
+				break;
+			default:
+				if ((unsigned char)*c < 0x20)
+					fprintf(stream, "\\x%02x", (unsigned char)*c);
+				else
+					fputc(*c, stream);
+				break;
+		}
+	}
+}
+
+static void SndCtlPropertyPrintString(FILE *stream, CFStringRef string) {
+	if (!string)
+		return;
+
+	CFIndex maxLength = CFStringGetMaximumSizeForEncoding(CFStringGetLength(string), kCFStringEncodingUTF8) + 1;
+	char *utf8 = malloc(maxLength);
+
+	if (CFStringGetCString(string, utf8, maxLength, kCFStringEncodingUTF8))
+		SndCtlPropertyPrintEscaped(stream, utf8);
+
+	free(utf8);
+	CFRelease(string);
+}
+
+static void SndCtlPropertyPrintValue(FILE *stream, SndCtlPropertyType type, const void *data, UInt32 size) {
+	switch (type) {
+		case SndCtlPropertyTypeUInt32:
+			fprintf(stream, "%u", *(const UInt32 *)data);
+			break;
+		case SndCtlPropertyTypeFourCharCode:
+			SndCtlPropertyPrintFourCharCode(stream, *(const UInt32 *)data);
+			break;
+		case SndCtlPropertyTypeFloat32:
+			fprintf(stream, "%g", *(const Float32 *)data);
+			break;
+		case SndCtlPropertyTypeFloat64:
+			fprintf(stream, "%g", *(const Float64 *)data);
+			break;
+		case SndCtlPropertyTypeString:
+			SndCtlPropertyPrintString(stream, *(const CFStringRef *)data);
+			break;
+		case SndCtlPropertyTypeUInt32List: {
+			const UInt32 *values = data;
+
+			for (UInt32 i = 0; i < size / sizeof(UInt32); ++i)
+				fprintf(stream, i > 0 ? ",%u" : "%u", values[i]);
+
+			break;
+		}
+		case SndCtlPropertyTypeValueRange:
+		case SndCtlPropertyTypeValueRangeList: {
+			const AudioValueRange *ranges = data;
+
+			for (UInt32 i = 0; i < size / sizeof(AudioValueRange); ++i)
+				fprintf(stream, i > 0 ? ",%g..%g" : "%g..%g", ranges[i].mMinimum, ranges[i].mMaximum);
+
+			break;
+		}
+		case SndCtlPropertyTypeBufferList: {
+			const AudioBufferList *bufferList = data;
+
+			for (UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
+				fprintf(stream, i > 0 ? ",%u" : "%u", bufferList->mBuffers[i].mNumberChannels);
+
+			break;
+		}
+		case SndCtlPropertyTypeStreamFormat: {
+			const AudioStreamBasicDescription *format = data;
+
+			fprintf(stream, "%g Hz ", format->mSampleRate);
+			SndCtlPropertyPrintFourCharCode(stream, format->mFormatID);
+			fprintf(stream, " %u ch %u bit flags 0x%x", format->mChannelsPerFrame, format->mBitsPerChannel, format->mFormatFlags);
+			break;
+		}
+		case SndCtlPropertyTypeRaw: {
+			const UInt8 *bytes = data;
+
+			for (UInt32 i = 0; i < size; ++i)
+				fprintf(stream, "%02x", bytes[i]);
+
+			break;
+		}
+	}
+}
+
+// The size of a type's data, or 0 for types whose size has to be asked for.
+static UInt32 SndCtlPropertyFixedSize(SndCtlPropertyType type) {
+	switch (type) {
+		case SndCtlPropertyTypeUInt32:
+		case SndCtlPropertyTypeFourCharCode:
+			return sizeof(UInt32);
+		case SndCtlPropertyTypeFloat32:
+			return sizeof(Float32);
+		case SndCtlPropertyTypeFloat64:
+			return sizeof(Float64);
+		case SndCtlPropertyTypeString:
+			return sizeof(CFStringRef);
+		case SndCtlPropertyTypeValueRange:
+			return sizeof(AudioValueRange);
+		case SndCtlPropertyTypeStreamFormat:
+			return sizeof(AudioStreamBasicDescription);
+		default:
+			return 0;
+	}
+}
+
+// Whether a buffer list's header and all the buffers it claims to have fit in size bytes, since a
+// short or corrupt reply (say, from a replay log) can claim more than it holds.
+static bool SndCtlPropertyBufferListFits(const void *data, UInt32 size) {
+	if (size < offsetof(AudioBufferList, mBuffers))
+		return false;
+
+	UInt32 bufferCount = ((const AudioBufferList *)data)->mNumberBuffers;
+
+	return offsetof(AudioBufferList, mBuffers) + (size_t)bufferCount * sizeof(AudioBuffer) <= size;
+}
+
+static void SndCtlPropertyFetch(AudioObjectID objectid, const SndCtlPropertyRequest *request, SndCtlPropertyResult *result) {
+	result->type = request->type;
+
+	// Scalars are one round trip; everything else needs its size first.
+	UInt32 size = SndCtlPropertyFixedSize(request->type);
+	UInt8 fixed[sizeof(AudioStreamBasicDescription)];
+	void *data = fixed;
+
+	if (size == 0) {
+		result->status = SndCtlHALGetPropertyDataSize(objectid, &request->address, 0, NULL, &size);
+
+		if (result->status != kAudioHardwareNoError)
+			return;
+
+		data = malloc(size > 0 ? size : 1);
+	}
+
+	UInt32 expectedSize = size;
+	result->status = SndCtlHALGetPropertyData(objectid, &request->address, 0, NULL, &size, data);
+
+	if (result->status == kAudioHardwareNoError && data == fixed && size != expectedSize) {
+		if (request->type == SndCtlPropertyTypeString && size == sizeof(CFStringRef))
+			CFRelease(*(CFStringRef *)data);
+
+		result->status = kAudioHardwareBadPropertySizeError;
+	} else if (result->status == kAudioHardwareNoError && request->type == SndCtlPropertyTypeBufferList && !SndCtlPropertyBufferListFits(data, size))
+		result->status = kAudioHardwareBadPropertySizeError;
+
+	if (result->status == kAudioHardwareNoError) {
+		size_t length;
+		FILE *stream = open_memstream(&result->value, &length);
+		SndCtlPropertyPrintValue(stream, request->type, data, size);
+		fclose(stream);
+	}
+
+	if (data != fixed)
+		free(data);
+}
+
+typedef struct {
+	const AudioObjectID *objectids;
+	size_t objectCount;
+	const SndCtlPropertyRequest *requests;
+	size_t requestCount;
+	SndCtlPropertyResult *results;
+} SndCtlPropertyQuery;
+
+static void SndCtlPropertyQueryObject(void *context, size_t i) {
+	SndCtlPropertyQuery *query = context;
+	AudioObjectID objectid = query->objectids[i];
+	SndCtlPropertyResult *results = &query->results[i * query->requestCount];
+
+	for (size_t j = 0; j < query->requestCount; ++j) {
+		// Don't spend the deadline on an object that's already stopped answering.
+		if (SndCtlHALObjectIsUnresponsive(objectid)) {
+			results[j].type = query->requests[j].type;
+			results[j].status = kSndCtlHALTimedOutError;
+			continue;
+		}
+
+		SndCtlPropertyFetch(objectid, &query->requests[j], &results[j]);
+	}
+}
+
+SndCtlPropertyResult *SndCtlPropertyCopyValues(const AudioObjectID *objectids, size_t objectCount, const SndCtlPropertyRequest *requests, size_t requestCount) {
+	SndCtlPropertyQuery query = {
+		.objectids = objectids,
+		.objectCount = objectCount,
+		.requests = requests,
+		.requestCount = requestCount,
+		.results = calloc(objectCount * requestCount + 1, sizeof(SndCtlPropertyResult)),
+	};
+
+	SndCtlParallelFor(objectCount, &query, SndCtlPropertyQueryObject);
+
+	return query.results;
+}
+
+void SndCtlPropertyResultsRelease(SndCtlPropertyResult *results, size_t count) {
+	if (!results)
+		return;
+
+	for (size_t i = 0; i < count; ++i)
+		free(results[i].value);
+
+	free(results);
+}
+
+bool SndCtlPropertySetValue(AudioObjectID objectid, const SndCtlPropertyRequest *request, const char *value, CFErrorRef *error) {
+	union {
+		UInt32 uint32;
+		Float32 float32;
+		Float64 float64;
+	} data;
+	UInt32 size;
+	char *endptr = NULL;
+
+	switch (request->type) {
+		case SndCtlPropertyTypeFourCharCode:
+		case SndCtlPropertyTypeUInt32:
+			size = sizeof(UInt32);
+
+			// Codes can be given quoted, like 'usb '.
+			if (request->type == SndCtlPropertyTypeFourCharCode && value[0] == '\'') {
+				if (SndCtlPropertyParseFourCharCode(value, &data.uint32))
+					endptr = "";
+			} else {
+				unsigned long number = strtoul(value, &endptr, 0);
+
+				if (number > UINT32_MAX)
+					endptr = NULL;
+
+				data.uint32 = (UInt32)number;
+			}
+
+			break;
+		case SndCtlPropertyTypeFloat32:
+			data.float32 = strtof_l(value, &endptr, NULL); // Always use the C locale.
+			size = sizeof(Float32);
+			break;
+		case SndCtlPropertyTypeFloat64:
+			data.float64 = strtod_l(value, &endptr, NULL); // Always use the C locale.
+			size = sizeof(Float64);
+			break;
+		default:
+			if (error)
+				*error = SndCtlPropertyErrorCreate(CFSTR("Property '%s' can't be set from the command line."), request->string);
+
+			return false;
+	}
+
+	if (!endptr || endptr == value || *endptr != '\0') {
+		if (error)
+			*error = SndCtlPropertyErrorCreate(CFSTR("Invalid value '%s'."), value);
+
+		return false;
+	}
+
+	OSStatus result = SndCtlHALSetPropertyData(objectid, &request->address, 0, NULL, size, &data);
+
+	if (result != kAudioHardwareNoError) {
+		if (error) {
+			CFStringRef localizedFailure = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("Couldn't set '%s' for device ID %u"), request->string, objectid);
+			*error = SndCtlErrorCreateWithOSStatus(result, localizedFailure);
+			CFRelease(localizedFailure);
+		}
+
+		return false;
+	}
+
+	return true;
+}
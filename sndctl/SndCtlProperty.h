@@ -0,0 +1,123 @@
+//
+//  SndCtlProperty.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlProperty_h
+#define SndCtlProperty_h
+
+#include <stdio.h>
+#include <AudioToolbox/AudioToolbox.h>
+
+/// How a property's data is laid out.
+typedef enum {
+	/// Unknown layout; shown as hex bytes.
+	SndCtlPropertyTypeRaw,
+	SndCtlPropertyTypeUInt32,
+	/// A \c UInt32 shown as a four-character code when it's printable.
+	SndCtlPropertyTypeFourCharCode,
+	SndCtlPropertyTypeFloat32,
+	SndCtlPropertyTypeFloat64,
+	/// A \c CFStringRef\n.
+	SndCtlPropertyTypeString,
+	/// An array of \c UInt32\n, such as object IDs or data source IDs.
+	SndCtlPropertyTypeUInt32List,
+	SndCtlPropertyTypeValueRange,
+	/// An array of \c AudioValueRange\n.
+	SndCtlPropertyTypeValueRangeList,
+	/// An \c AudioBufferList\n, shown as the channel count of each buffer.
+	SndCtlPropertyTypeBufferList,
+	SndCtlPropertyTypeStreamFormat,
+} SndCtlPropertyType;
+
+/// A property sndctl knows by name.
+typedef struct {
+	/// Short lowercase name, e.g. \c "samplerate"\n.
+	const char *name;
+	AudioObjectPropertySelector selector;
+	SndCtlPropertyType type;
+	/// The scope used when a request doesn't give one.
+	AudioObjectPropertyScope defaultScope;
+} SndCtlPropertyDescriptor;
+
+/// A property to get or set, parsed from \c selector[:scope[:element]]\n.
+typedef struct {
+	AudioObjectPropertyAddress address;
+	SndCtlPropertyType type;
+	/// The request as written, for output.
+	const char *string;
+} SndCtlPropertyRequest;
+
+/// The outcome of getting one property of one object.
+typedef struct {
+	OSStatus status;
+	SndCtlPropertyType type;
+	/// The formatted value, or \c NULL on failure.
+	char *value;
+} SndCtlPropertyResult;
+
+/**
+ Get the descriptors of every property sndctl knows by name.
+ @param count	Set to the number of descriptors.
+ */
+const SndCtlPropertyDescriptor *SndCtlPropertyDescriptors(size_t *count);
+
+/**
+ Get the name sndctl uses for a property selector.
+ @return The name, or \c NULL if the selector isn't in the table.
+ */
+const char *SndCtlNameForDeviceProperty(AudioObjectPropertySelector selector);
+
+/**
+ Get a short lowercase name for a property type, e.g. \c "float64"\n.
+ */
+const char *SndCtlNameForPropertyType(SndCtlPropertyType type);
+
+/**
+ Parse a property request.
+ @param string	\c selector[:scope[:element]]\n. The selector is a name from the table or a
+ 				four-character code in single quotes; the scope is \c global\n, \c input\n,
+ 				\c output\n, \c playthrough or a quoted four-character code; the element is a
+ 				number or \c main\n.
+ 				\c string must outlive the request.
+ @param request	Set to the parsed request.
+ @param error	An error on failure.
+ @return Whether \c string could be parsed.
+ @discussion Four-character codes that aren't in the table have type \c SndCtlPropertyTypeRaw\n.
+ */
+bool SndCtlPropertyRequestParse(const char *string, SndCtlPropertyRequest *request, CFErrorRef *error);
+
+/**
+ Get many properties of many objects at once.
+ @param objectids		The objects.
+ @param objectCount		The number of objects.
+ @param requests		The properties to get from each object.
+ @param requestCount	The number of requests.
+ @return \c objectCount \c * \c requestCount results, object-major. Free them with
+ 	\c SndCtlPropertyResultsRelease()\n.
+ @discussion Objects are queried side by side on a small pool of threads; each object's
+ 	properties are fetched in order. Once an object misses a HAL deadline its remaining
+ 	properties aren't asked for.
+ */
+SndCtlPropertyResult *SndCtlPropertyCopyValues(const AudioObjectID *objectids, size_t objectCount, const SndCtlPropertyRequest *requests, size_t requestCount);
+
+/**
+ Free results from \c SndCtlPropertyCopyValues()\n.
+ */
+void SndCtlPropertyResultsRelease(SndCtlPropertyResult *results, size_t count);
+
+/**
+ Set a property from a string.
+ @param objectid	The object.
+ @param request		The property. Only scalar types can be set.
+ @param value		The value: a number, or for four-character codes either a number or a code in
+ 					single quotes.
+ @param error		An error on failure.
+ @return Whether the property was set.
+ */
+bool SndCtlPropertySetValue(AudioObjectID objectid, const SndCtlPropertyRequest *request, const char *value, CFErrorRef *error);
+
+#endif /* SndCtlProperty_h */
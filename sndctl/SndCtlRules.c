@@ -0,0 +1,485 @@
+//
+//  SndCtlRules.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlRules.h"
+#include "SndCtlAudioUtils.h"
+#include "SndCtlError.h"
+#include "SndCtlHAL.h"
+#include <ctype.h>
+#include <errno.h>
+#include <xlocale.h>
+
+typedef struct {
+	unsigned line;
+	char *selectorString;
+	SndCtlDeviceSelectorRef selector;
+	SndCtlRuleTrigger trigger;
+	bool makeDefault;
+	/// \c NAN if the rule doesn't set it.
+	Float32 volume;
+	/// \c NAN if the rule doesn't set it.
+	Float32 balance;
+} SndCtlRule;
+
+struct SndCtlRuleSet {
+	/// One for the owner and one per event on its way through the queue. A HAL listener can still be
+	/// running after it's removed, so the set is only freed when this drops to 0.
+	int refCount;
+	size_t count;
+	SndCtlRule *rules;
+	/// Everything the rules' selectors need, plus names for reports.
+	SndCtlDeviceField fields;
+
+	// Only touched on the queue once monitoring starts.
+	dispatch_queue_t queue;
+	bool monitoring;
+	SndCtlRuleReportHandler handler;
+	void *context;
+	AudioObjectID *knownDevices;
+	CFIndex knownCount;
+	AudioObjectID defaultDeviceID;
+};
+
+typedef struct {
+	SndCtlRuleSetRef rules;
+	UInt64 timestamp;
+} SndCtlRuleEvent;
+
+static const AudioObjectPropertyAddress kSndCtlRulesDevicesAddress = {
+	kAudioHardwarePropertyDevices,
+	kAudioObjectPropertyScopeGlobal,
+	kAudioObjectPropertyElementMaster
+};
+
+static const AudioObjectPropertyAddress kSndCtlRulesDefaultDeviceAddress = {
+	kAudioHardwarePropertyDefaultOutputDevice,
+	kAudioObjectPropertyScopeGlobal,
+	kAudioObjectPropertyElementMaster
+};
+
+static char *SndCtlRulesSkipSpace(char *str) {
+	while (isspace((unsigned char)*str))
+		++str;
+
+	return str;
+}
+
+// Consumes a keyword followed by a space, a colon, a comma or the end of the string.
+static bool SndCtlRulesConsumeKeyword(char **cursor, const char *keyword) {
+	size_t length = strlen(keyword);
+
+	if (strncasecmp(*cursor, keyword, length) != 0)
+		return false;
+
+	char next = (*cursor)[length];
+
+	if (next != '\0' && next != ':' && next != ',' && !isspace((unsigned char)next))
+		return false;
+
+	*cursor = SndCtlRulesSkipSpace(*cursor + length);
+	return true;
+}
+
+static bool SndCtlRulesParseValue(char **cursor, bool allowBalanceNames, Float32 *value) {
+	char *start = *cursor;
+
+	if (allowBalanceNames && (start[1] == '\0' || start[1] == ',' || isspace((unsigned char)start[1]))) {
+		switch (tolower((unsigned char)*start)) {
+			case 'l':
+				*value = 0.0;
+				break;
+			case 'r':
+				*value = 1.0;
+				break;
+			case 'c':
+				*value = 0.5;
+				break;
+			default:
+				goto number;
+		}
+
+		*cursor = SndCtlRulesSkipSpace(start + 1);
+		return true;
+	}
+
+number:
+	*value = strtof_l(start, cursor, NULL); // Always use the C locale.
+
+	if (*cursor == start || *value < 0.0 || *value > 1.0)
+		return false;
+
+	*cursor = SndCtlRulesSkipSpace(*cursor);
+	return true;
+}
+
+static bool SndCtlRulesParseLine(char *line, SndCtlRule *rule, CFErrorRef *error) {
+	char *cursor = SndCtlRulesSkipSpace(line);
+
+	if (!SndCtlRulesConsumeKeyword(&cursor, "when"))
+		return false;
+
+	char quote = *cursor;
+
+	if (quote != '"' && quote != '\'')
+		return false;
+
+	char *selectorStart = cursor + 1;
+	char *selectorEnd = strchr(selectorStart, quote);
+
+	if (!selectorEnd)
+		return false;
+
+	*selectorEnd = '\0';
+	cursor = SndCtlRulesSkipSpace(selectorEnd + 1);
+
+	if (SndCtlRulesConsumeKeyword(&cursor, "appears"))
+		rule->trigger = SndCtlRuleTriggerAppears;
+	else if (SndCtlRulesConsumeKeyword(&cursor, "becomes") && SndCtlRulesConsumeKeyword(&cursor, "default"))
+		rule->trigger = SndCtlRuleTriggerBecomesDefault;
+	else
+		return false;
+
+	if (*cursor != ':')
+		return false;
+
+	cursor = SndCtlRulesSkipSpace(cursor + 1);
+
+	rule->volume = NAN;
+	rule->balance = NAN;
+
+	do {
+		if (SndCtlRulesConsumeKeyword(&cursor, "default"))
+			rule->makeDefault = true;
+		else if (SndCtlRulesConsumeKeyword(&cursor, "volume")) {
+			if (!SndCtlRulesParseValue(&cursor, false, &rule->volume))
+				return false;
+		} else if (SndCtlRulesConsumeKeyword(&cursor, "balance")) {
+			if (!SndCtlRulesParseValue(&cursor, true, &rule->balance))
+				return false;
+		} else
+			return false;
+	} while (*cursor == ',' && (cursor = SndCtlRulesSkipSpace(cursor + 1)));
+
+	if (*cursor != '\0')
+		return false;
+
+	// Parse errors in the selector itself are more useful than a generic one for the line.
+	rule->selector = SndCtlDeviceSelectorCreate(selectorStart, error);
+
+	if (!rule->selector)
+		return false;
+
+	rule->selectorString = strdup(selectorStart);
+
+	return true;
+}
+
+SndCtlRuleSetRef SndCtlRuleSetCreateWithFile(const char *path, CFErrorRef *error) {
+	FILE *file = fopen(path, "r");
+
+	if (!file) {
+		if (error) {
+			CFStringRef description = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("Couldn't open rules file '%s'."), path);
+			*error = SndCtlErrorCreateWithPOSIXCode(errno, description);
+			CFRelease(description);
+		}
+
+		return NULL;
+	}
+
+	SndCtlRuleSetRef rules = calloc(1, sizeof(struct SndCtlRuleSet));
+	rules->refCount = 1;
+	rules->fields = SndCtlDeviceFieldName;
+
+	size_t capacity = 0;
+	char *line = NULL;
+	size_t lineCapacity = 0;
+	unsigned lineNumber = 0;
+
+	while (getline(&line, &lineCapacity, file) != -1) {
+		++lineNumber;
+		line[strcspn(line, "\r\n")] = '\0';
+
+		char *start = SndCtlRulesSkipSpace(line);
+
+		if (*start == '\0' || *start == '#')
+			continue;
+
+		if (rules->count == capacity) {
+			capacity = capacity ? capacity * 2 : 8;
+			rules->rules = realloc(rules->rules, capacity * sizeof(SndCtlRule));
+		}
+
+		SndCtlRule *rule = &rules->rules[rules->count];
+		*rule = (SndCtlRule){ .line = lineNumber };
+		CFErrorRef lineError = NULL;
+
+		if (!SndCtlRulesParseLine(start, rule, &lineError)) {
+			if (error) {
+				CFStringRef description = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("%s:%u: Invalid rule."), path, lineNumber);
+
+				// Selector errors say what's wrong with the selector, so keep their description.
+				if (lineError) {
+					CFStringRef reason = CFErrorCopyDescription(lineError);
+					CFRelease(description);
+					description = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("%s:%u: %@"), path, lineNumber, reason);
+					CFRelease(reason);
+				}
+
+				*error = SndCtlErrorCreate(SndCtlErrorInvalidRule, description);
+				CFRelease(description);
+			}
+
+			if (lineError)
+				CFRelease(lineError);
+
+			SndCtlDeviceSelectorRelease(rule->selector);
+			free(line);
+			fclose(file);
+			SndCtlRuleSetRelease(rules);
+			return NULL;
+		}
+
+		rules->fields |= SndCtlDeviceSelectorRequiredFields(rule->selector);
+		++rules->count;
+	}
+
+	free(line);
+	fclose(file);
+
+	return rules;
+}
+
+size_t SndCtlRuleSetGetCount(SndCtlRuleSetRef rules) {
+	return rules->count;
+}
+
+static void SndCtlRuleApply(SndCtlRuleSetRef rules, const SndCtlRule *rule, const SndCtlDeviceInfo *device, UInt64 timestamp) {
+	CFErrorRef error = NULL;
+	bool success = true;
+
+	if (rule->makeDefault)
+		success = SndCtlSetDefaultOutputDeviceID(device->deviceid, &error);
+	if (success && !isnan(rule->volume))
+		success = SndCtlSetVolume(device->deviceid, rule->volume, &error);
+	if (success && !isnan(rule->balance))
+		success = SndCtlSetBalance(device->deviceid, rule->balance, &error);
+
+	SndCtlRuleReport report = {
+		.line = rule->line,
+		.selector = rule->selectorString,
+		.trigger = rule->trigger,
+		.deviceid = device->deviceid,
+		.deviceName = device->name,
+		.success = success,
+		.error = error,
+		.reactionTime = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - timestamp,
+	};
+
+	if (rules->handler)
+		rules->handler(&report, rules->context);
+
+	if (error)
+		CFRelease(error);
+}
+
+static bool SndCtlRuleSetKnowsDevice(SndCtlRuleSetRef rules, AudioObjectID deviceid) {
+	for (CFIndex i = 0; i < rules->knownCount; ++i) {
+		if (rules->knownDevices[i] == deviceid)
+			return true;
+	}
+
+	return false;
+}
+
+static const SndCtlDeviceInfo *SndCtlDeviceTableFindDevice(const SndCtlDeviceTable *table, AudioObjectID deviceid) {
+	for (CFIndex i = 0; i < table->count; ++i) {
+		if (table->devices[i].deviceid == deviceid)
+			return &table->devices[i];
+	}
+
+	return NULL;
+}
+
+// Remembers the current devices and default so later changes can be told apart from them.
+static void SndCtlRuleSetRemember(SndCtlRuleSetRef rules, const SndCtlDeviceTable *table, AudioObjectID defaultDeviceID) {
+	rules->knownDevices = realloc(rules->knownDevices, (table->count > 0 ? table->count : 1) * sizeof(AudioObjectID));
+	rules->knownCount = table->count;
+
+	for (CFIndex i = 0; i < table->count; ++i)
+		rules->knownDevices[i] = table->devices[i].deviceid;
+
+	rules->defaultDeviceID = defaultDeviceID;
+}
+
+static void SndCtlRuleSetFree(SndCtlRuleSetRef rules) {
+	for (size_t i = 0; i < rules->count; ++i) {
+		SndCtlDeviceSelectorRelease(rules->rules[i].selector);
+		free(rules->rules[i].selectorString);
+	}
+
+	// Fine even from a block on the queue, which keeps the queue alive until it returns.
+	if (rules->queue)
+		dispatch_release(rules->queue);
+
+	free(rules->rules);
+	free(rules->knownDevices);
+	free(rules);
+}
+
+static void SndCtlRuleSetRetain(SndCtlRuleSetRef rules) {
+	__atomic_add_fetch(&rules->refCount, 1, __ATOMIC_RELAXED);
+}
+
+static void SndCtlRuleSetDrop(void *context) {
+	SndCtlRuleSetRef rules = context;
+
+	if (__atomic_sub_fetch(&rules->refCount, 1, __ATOMIC_ACQ_REL) == 0)
+		SndCtlRuleSetFree(rules);
+}
+
+// Frees an event and drops the reference it held.
+static void SndCtlRuleEventFree(SndCtlRuleEvent *event) {
+	SndCtlRuleSetRef rules = event->rules;
+	free(event);
+	SndCtlRuleSetDrop(rules);
+}
+
+static void SndCtlRuleSetEvaluate(void *context) {
+	SndCtlRuleEvent *event = context;
+	SndCtlRuleSetRef rules = event->rules;
+
+	if (!rules->monitoring) {
+		SndCtlRuleEventFree(event);
+		return;
+	}
+
+	SndCtlDeviceTable *table = SndCtlDeviceTableCreate(rules->fields, NULL);
+
+	if (!table) {
+		SndCtlRuleEventFree(event);
+		return;
+	}
+
+	for (CFIndex i = 0; i < table->count; ++i) {
+		const SndCtlDeviceInfo *device = &table->devices[i];
+
+		if (SndCtlRuleSetKnowsDevice(rules, device->deviceid))
+			continue;
+
+		for (size_t j = 0; j < rules->count; ++j) {
+			const SndCtlRule *rule = &rules->rules[j];
+
+			if (rule->trigger == SndCtlRuleTriggerAppears && SndCtlDeviceSelectorMatches(rule->selector, device))
+				SndCtlRuleApply(rules, rule, device, event->timestamp);
+		}
+	}
+
+	// Read after the appear rules so that a default they set is handled now rather than on its own notification.
+	AudioObjectID defaultDeviceID = SndCtlDefaultOutputDeviceID(NULL);
+	const SndCtlDeviceInfo *defaultDevice = defaultDeviceID != rules->defaultDeviceID ? SndCtlDeviceTableFindDevice(table, defaultDeviceID) : NULL;
+
+	if (defaultDevice) {
+		for (size_t j = 0; j < rules->count; ++j) {
+			const SndCtlRule *rule = &rules->rules[j];
+
+			if (rule->trigger == SndCtlRuleTriggerBecomesDefault && SndCtlDeviceSelectorMatches(rule->selector, defaultDevice))
+				SndCtlRuleApply(rules, rule, defaultDevice, event->timestamp);
+		}
+	}
+
+	SndCtlRuleSetRemember(rules, table, defaultDeviceID);
+	SndCtlDeviceTableRelease(table);
+	SndCtlRuleEventFree(event);
+}
+
+static OSStatus SndCtlRuleSetListener(AudioObjectID objectid, UInt32 addressCount, const AudioObjectPropertyAddress *addresses, void *clientData) {
+	SndCtlRuleSetRef rules = clientData;
+
+	// Timed here, on the HAL's notification thread, so the reaction time includes any queueing.
+	// The event's reference is taken first, so the set outlives this call even if it's released meanwhile.
+	SndCtlRuleSetRetain(rules);
+	SndCtlRuleEvent *event = malloc(sizeof(SndCtlRuleEvent));
+	event->rules = rules;
+	event->timestamp = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+	dispatch_async_f(rules->queue, event, SndCtlRuleSetEvaluate);
+
+	return kAudioHardwareNoError;
+}
+
+static void SndCtlRuleSetStartOnQueue(void *context) {
+	SndCtlRuleSetRef rules = context;
+	SndCtlDeviceTable *table = SndCtlDeviceTableCreate(rules->fields, NULL);
+
+	if (table) {
+		SndCtlRuleSetRemember(rules, table, SndCtlDefaultOutputDeviceID(NULL));
+		SndCtlDeviceTableRelease(table);
+	}
+
+	rules->monitoring = true;
+}
+
+static void SndCtlRuleSetStopOnQueue(void *context) {
+	SndCtlRuleSetRef rules = context;
+	rules->monitoring = false;
+}
+
+bool SndCtlRuleSetStartMonitoring(SndCtlRuleSetRef rules, SndCtlRuleReportHandler handler, void *context, CFErrorRef *error) {
+	if (!rules->queue)
+		rules->queue = dispatch_queue_create("org.derailer.sndctl.rules", DISPATCH_QUEUE_SERIAL);
+
+	rules->handler = handler;
+	rules->context = context;
+
+	// Take the starting snapshot before any notification can be handled.
+	dispatch_sync_f(rules->queue, rules, SndCtlRuleSetStartOnQueue);
+
+	OSStatus result = SndCtlHALAddPropertyListener(kAudioObjectSystemObject, &kSndCtlRulesDevicesAddress, SndCtlRuleSetListener, rules);
+
+	if (result == kAudioHardwareNoError) {
+		result = SndCtlHALAddPropertyListener(kAudioObjectSystemObject, &kSndCtlRulesDefaultDeviceAddress, SndCtlRuleSetListener, rules);
+
+		if (result != kAudioHardwareNoError)
+			SndCtlHALRemovePropertyListener(kAudioObjectSystemObject, &kSndCtlRulesDevicesAddress, SndCtlRuleSetListener, rules);
+	}
+
+	if (result != kAudioHardwareNoError) {
+		if (error)
+			*error = SndCtlErrorCreateWithOSStatus(result, CFSTR("Couldn't watch for device changes."));
+
+		dispatch_sync_f(rules->queue, rules, SndCtlRuleSetStopOnQueue);
+		return false;
+	}
+
+	return true;
+}
+
+void SndCtlRuleSetStopMonitoring(SndCtlRuleSetRef rules) {
+	if (!rules->queue)
+		return;
+
+	SndCtlHALRemovePropertyListener(kAudioObjectSystemObject, &kSndCtlRulesDevicesAddress, SndCtlRuleSetListener, rules);
+	SndCtlHALRemovePropertyListener(kAudioObjectSystemObject, &kSndCtlRulesDefaultDeviceAddress, SndCtlRuleSetListener, rules);
+
+	dispatch_sync_f(rules->queue, rules, SndCtlRuleSetStopOnQueue);
+}
+
+void SndCtlRuleSetRelease(SndCtlRuleSetRef rules) {
+	if (!rules)
+		return;
+
+	SndCtlRuleSetStopMonitoring(rules);
+
+	// Drop the owner's reference behind any events that are already queued. Listener calls that
+	// were in progress when the listeners were removed hold their own references.
+	if (rules->queue)
+		dispatch_async_f(rules->queue, rules, SndCtlRuleSetDrop);
+	else
+		SndCtlRuleSetDrop(rules);
+}
@@ -0,0 +1,98 @@
+//
+//  SndCtlRules.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlRules_h
+#define SndCtlRules_h
+
+#include <dispatch/dispatch.h>
+#include "SndCtlDeviceSelector.h"
+
+/**
+ Rules that react to output devices appearing or becoming the default.
+
+ A rules file has one rule per line; blank lines and lines starting with \c # are ignored:
+
+ 	when "USB Audio" appears: default, volume 0.35, balance c
+ 	when "transport=bluetooth" becomes default: volume 0.2
+
+ The quoted string is a device selector (see \c SndCtlDeviceSelectorCreate()\n), in single or
+ double quotes. Actions are \c default\n, \c volume <value> and \c balance <value>\n, where
+ balance also takes \c l\n, \c r and \c c\n. Actions are applied in that order whatever order
+ they're written in. Every matching rule is applied, in file order.
+ */
+typedef struct SndCtlRuleSet *SndCtlRuleSetRef;
+
+/// What a rule reacts to.
+typedef enum {
+	/// A matching device was added.
+	SndCtlRuleTriggerAppears,
+	/// A matching device became the default output device.
+	SndCtlRuleTriggerBecomesDefault,
+} SndCtlRuleTrigger;
+
+/// Describes a rule that was applied.
+typedef struct {
+	/// The rule's line in its file.
+	unsigned line;
+	/// The rule's selector, as written.
+	const char *selector;
+	SndCtlRuleTrigger trigger;
+	AudioObjectID deviceid;
+	/// The device's name, or \c NULL if it couldn't be read.
+	const char *deviceName;
+	/// Whether all of the rule's actions succeeded.
+	bool success;
+	/// The first error on failure. It's released after the handler returns.
+	CFErrorRef error;
+	/// Nanoseconds from the HAL's change notification to the rule's last action finishing.
+	UInt64 reactionTime;
+} SndCtlRuleReport;
+
+/// Called after each rule is applied.
+typedef void (*SndCtlRuleReportHandler)(const SndCtlRuleReport *report, void *context);
+
+/**
+ Load rules from a file.
+ @param path	The rules file.
+ @param error	An error on failure, naming the offending line if the file couldn't be parsed.
+ @return A new rule set, or \c NULL on failure. Free it with \c SndCtlRuleSetRelease()\n.
+ */
+SndCtlRuleSetRef SndCtlRuleSetCreateWithFile(const char *path, CFErrorRef *error);
+
+/**
+ Get the number of rules in a set.
+ */
+size_t SndCtlRuleSetGetCount(SndCtlRuleSetRef rules);
+
+/**
+ Start applying rules as devices change.
+ @param rules	The rules.
+ @param handler	Called on an internal serial queue after each rule is applied.
+ @param context	Passed to \c handler\n.
+ @param error	An error on failure.
+ @return Whether the HAL notifications could be registered.
+ @discussion Devices that are already present, and the current default device, don't trigger rules.
+ 	Each change is matched against a single device table fetched with only the attributes the
+ 	rules' selectors need.
+ */
+bool SndCtlRuleSetStartMonitoring(SndCtlRuleSetRef rules, SndCtlRuleReportHandler handler, void *context, CFErrorRef *error);
+
+/**
+ Stop applying rules.
+ @discussion Evaluations already in progress finish first.
+ */
+void SndCtlRuleSetStopMonitoring(SndCtlRuleSetRef rules);
+
+/**
+ Free a rule set, stopping it first if needed.
+ @discussion No reports are delivered once this returns. The memory itself is freed once any
+ 	notifications already on their way have been dropped.
+ */
+void SndCtlRuleSetRelease(SndCtlRuleSetRef rules);
+
+#endif /* SndCtlRules_h */
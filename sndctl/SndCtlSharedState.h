@@ -0,0 +1,218 @@
+//
+//  SndCtlSharedState.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlSharedState_h
+#define SndCtlSharedState_h
+
+/**
+ Reading the audio state published by \c sndctl \c --publish\n.
+
+ The publisher keeps the default output device and each output device's volume, balance and mute
+ in a small POSIX shared-memory segment, updated whenever the HAL reports a change. Readers map it
+ once and can then take snapshots as often as they like without any system or HAL calls.
+
+ Snapshots are guarded by a sequence counter that's odd while the publisher is writing. A reader
+ copies the snapshot between two reads of the counter and retries if it changed, so it never sees
+ a half-written update and never blocks the publisher.
+
+ A publisher that exits normally clears \c publisherPID\n, but one that crashes or is killed
+ can't. So it also stores the time in \c heartbeat every \c kSndCtlSharedStateHeartbeatInterval
+ while it runs, whether or not anything changed. The state is stale, and shouldn't be trusted, if
+ \c publisherPID is \c 0 or the heartbeat is more than \c kSndCtlSharedStateStaleInterval old;
+ \c SndCtlSharedStateIsLive() applies this rule. \c updated only changes with the snapshot, so it
+ says how old the values are, not whether anyone is still keeping them current.
+
+ This header only depends on the C library so that other programs can include it as is:
+
+ 	const SndCtlSharedStateSegment *segment = SndCtlSharedStateMap();
+ 	SndCtlSharedStateSnapshot snapshot;
+
+ 	if (segment && SndCtlSharedStateRead(segment, &snapshot) && SndCtlSharedStateIsLive(segment, &snapshot))
+ 		printf("%u\n", snapshot.defaultDeviceID);
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define kSndCtlSharedStateMagic			0x736e6463	// 'sndc'
+#define kSndCtlSharedStateVersion		2
+#define kSndCtlSharedStateMaxDevices	32
+#define kSndCtlSharedStateNameLength	64
+/// How often the publisher updates the heartbeat, in nanoseconds.
+#define kSndCtlSharedStateHeartbeatInterval	1000000000ULL
+/// How old the heartbeat can get before the state is considered stale, in nanoseconds.
+#define kSndCtlSharedStateStaleInterval		(3 * kSndCtlSharedStateHeartbeatInterval)
+
+/// Flags for \c SndCtlSharedDeviceState\n.
+enum {
+	SndCtlSharedDeviceHasVolume		= 1 << 0,
+	SndCtlSharedDeviceHasBalance	= 1 << 1,
+	SndCtlSharedDeviceHasMute		= 1 << 2,
+	SndCtlSharedDeviceMuted			= 1 << 3,
+};
+
+/// One output device.
+typedef struct {
+	uint32_t deviceid;
+	uint32_t flags;
+	/// Only valid with \c SndCtlSharedDeviceHasVolume\n.
+	float volume;
+	/// Only valid with \c SndCtlSharedDeviceHasBalance\n.
+	float balance;
+	/// UTF-8, truncated at a character boundary if needed and always terminated.
+	char name[kSndCtlSharedStateNameLength];
+} SndCtlSharedDeviceState;
+
+/// Everything that's published at once.
+typedef struct {
+	/// Incremented each time anything in the snapshot changes.
+	uint64_t generation;
+	/// When the snapshot was published, in \c CLOCK_UPTIME_RAW nanoseconds.
+	uint64_t updated;
+	uint32_t publisherPID;
+	uint32_t defaultDeviceID;
+	uint32_t deviceCount;
+	uint32_t reserved;
+	/// Ordered by device ID.
+	SndCtlSharedDeviceState devices[kSndCtlSharedStateMaxDevices];
+} SndCtlSharedStateSnapshot;
+
+/// The shared-memory segment.
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	/// Odd while the publisher is writing \c snapshot\n.
+	uint32_t sequence;
+	uint32_t reserved;
+	/// When the publisher last showed it was running, in \c CLOCK_UPTIME_RAW nanoseconds. Read it atomically.
+	uint64_t heartbeat;
+	SndCtlSharedStateSnapshot snapshot;
+} SndCtlSharedStateSegment;
+
+/**
+ Get the segment's name for the current user.
+ @discussion Each user's publisher has its own segment. The name fits the 31-character limit
+ 	macOS puts on shared-memory names.
+ */
+static inline void SndCtlSharedStateGetName(char *name, size_t size) {
+	snprintf(name, size, "/sndctl.state.%u", (unsigned)getuid());
+}
+
+/**
+ Map the current user's segment read-only.
+ @return The segment, or \c NULL with \c errno set if there's no publisher, the segment is from
+ 	an incompatible version, or it belongs to another user. Unmap it with \c SndCtlSharedStateUnmap()\n.
+ @discussion The publisher creates the segment readable and writable by its user only.
+ */
+static inline const SndCtlSharedStateSegment *SndCtlSharedStateMap(void) {
+	char name[32];
+	SndCtlSharedStateGetName(name, sizeof(name));
+
+	int fd = shm_open(name, O_RDONLY, 0);
+
+	if (fd == -1)
+		return NULL;
+
+	// Names are predictable, so don't trust a segment someone else made first.
+	struct stat info;
+
+	if (fstat(fd, &info) == -1 || info.st_uid != getuid()) {
+		close(fd);
+		errno = EPERM;
+		return NULL;
+	}
+
+	void *memory = mmap(NULL, sizeof(SndCtlSharedStateSegment), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (memory == MAP_FAILED)
+		return NULL;
+
+	const SndCtlSharedStateSegment *segment = memory;
+
+	if (segment->magic != kSndCtlSharedStateMagic || segment->version != kSndCtlSharedStateVersion) {
+		munmap(memory, sizeof(SndCtlSharedStateSegment));
+		errno = EPROTO;
+		return NULL;
+	}
+
+	return segment;
+}
+
+/**
+ Unmap a segment from \c SndCtlSharedStateMap()\n.
+ */
+static inline void SndCtlSharedStateUnmap(const SndCtlSharedStateSegment *segment) {
+	if (segment)
+		munmap((void *)segment, sizeof(SndCtlSharedStateSegment));
+}
+
+/**
+ Take a consistent snapshot.
+ @param segment		A mapped segment.
+ @param snapshot	Set to the snapshot on success.
+ @return Whether a consistent snapshot was taken. This only fails if the publisher stopped in the
+ 	middle of an update or keeps updating faster than the snapshot can be copied.
+ @discussion Makes no system calls.
+ */
+static inline bool SndCtlSharedStateRead(const SndCtlSharedStateSegment *segment, SndCtlSharedStateSnapshot *snapshot) {
+	for (unsigned attempt = 0; attempt < 10000; ++attempt) {
+		uint32_t before = __atomic_load_n(&segment->sequence, __ATOMIC_ACQUIRE);
+
+		if (before & 1)
+			continue;
+
+		memcpy(snapshot, (const void *)&segment->snapshot, sizeof(SndCtlSharedStateSnapshot));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		if (__atomic_load_n(&segment->sequence, __ATOMIC_RELAXED) == before)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ Returns whether a snapshot is still being kept up to date.
+ @param segment		The segment \c snapshot was read from.
+ @param snapshot	A snapshot from \c SndCtlSharedStateRead()\n.
+ @discussion Checks \c publisherPID and the heartbeat as described at the top of this header.
+ 	Makes no system calls.
+ */
+static inline bool SndCtlSharedStateIsLive(const SndCtlSharedStateSegment *segment, const SndCtlSharedStateSnapshot *snapshot) {
+	if (snapshot->publisherPID == 0)
+		return false;
+
+	uint64_t heartbeat = __atomic_load_n(&segment->heartbeat, __ATOMIC_RELAXED);
+	uint64_t now = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+	return now < heartbeat || now - heartbeat <= kSndCtlSharedStateStaleInterval;
+}
+
+/**
+ Find a device in a snapshot.
+ @return The device, or \c NULL if it isn't in the snapshot.
+ */
+static inline const SndCtlSharedDeviceState *SndCtlSharedStateFindDevice(const SndCtlSharedStateSnapshot *snapshot, uint32_t deviceid) {
+	for (uint32_t i = 0; i < snapshot->deviceCount && i < kSndCtlSharedStateMaxDevices; ++i) {
+		if (snapshot->devices[i].deviceid == deviceid)
+			return &snapshot->devices[i];
+	}
+
+	return NULL;
+}
+
+#endif /* SndCtlSharedState_h */
@@ -0,0 +1,398 @@
+//
+//  SndCtlStatePublisher.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlStatePublisher.h"
+#include "SndCtlSharedState.h"
+#include "SndCtlAudioUtils.h"
+#include "SndCtlDeviceTable.h"
+#include "SndCtlError.h"
+#include "SndCtlHAL.h"
+#include <dispatch/dispatch.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+struct SndCtlStatePublisher {
+	/// One for the owner, one per listener call in progress and one per queued update. A HAL
+	/// listener can still be running after it's removed, so the publisher is only freed when this drops to 0.
+	int refCount;
+	SndCtlSharedStateSegment *segment;
+	dispatch_queue_t queue;
+	/// Keeps the segment's heartbeat current while publishing.
+	dispatch_source_t heartbeatTimer;
+	/// Set while an update is queued, so notifications that arrive before it runs don't queue more.
+	int updatePending;
+
+	// Only touched on the queue once publishing starts.
+	bool publishing;
+	/// Devices with volume, balance and mute listeners.
+	AudioObjectID *watchedDevices;
+	CFIndex watchedCount;
+	/// The last snapshot written to the segment.
+	SndCtlSharedStateSnapshot published;
+};
+
+static const AudioObjectPropertyAddress kSndCtlStatePublisherSystemAddresses[] = {
+	{ kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMaster },
+	{ kAudioHardwarePropertyDefaultOutputDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMaster },
+};
+
+static const AudioObjectPropertyAddress kSndCtlStatePublisherDeviceAddresses[] = {
+	{ kAudioHardwareServiceDeviceProperty_VirtualMainVolume, kAudioObjectPropertyScopeOutput, kAudioObjectPropertyElementMaster },
+	{ kAudioHardwareServiceDeviceProperty_VirtualMainBalance, kAudioObjectPropertyScopeOutput, kAudioObjectPropertyElementMaster },
+	{ kAudioDevicePropertyMute, kAudioObjectPropertyScopeOutput, kAudioObjectPropertyElementMaster },
+};
+
+// The last of the device addresses.
+static const AudioObjectPropertyAddress * const kSndCtlStatePublisherMuteAddress = &kSndCtlStatePublisherDeviceAddresses[2];
+
+static const size_t kSndCtlStatePublisherDeviceAddressCount = sizeof(kSndCtlStatePublisherDeviceAddresses) / sizeof(kSndCtlStatePublisherDeviceAddresses[0]);
+
+SndCtlStatePublisherRef SndCtlStatePublisherCreate(CFErrorRef *error) {
+	char name[32];
+	SndCtlSharedStateGetName(name, sizeof(name));
+
+	// Only the user's own processes can read the state.
+	int fd = shm_open(name, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	struct stat info;
+
+	if (fd != -1 && fstat(fd, &info) == 0 && info.st_uid != getuid()) {
+		if (error)
+			*error = SndCtlErrorCreateWithPOSIXCode(EPERM, CFSTR("The shared state segment belongs to another user."));
+
+		close(fd);
+		return NULL;
+	}
+
+	// A segment from an older, smaller layout can't be resized, and one that others can read
+	// can't be fixed reliably, so start over with a new one. Readers still mapping the old one
+	// see its old version or no publisher and stop trusting it.
+	if (fd != -1 && fstat(fd, &info) == 0 && ((info.st_size != 0 && info.st_size < (off_t)sizeof(SndCtlSharedStateSegment)) || (info.st_mode & (S_IRWXG | S_IRWXO)))) {
+		close(fd);
+		shm_unlink(name);
+		fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	}
+
+	// The size can only be set once, when the segment is new.
+	if (fd == -1 || fstat(fd, &info) == -1 || (info.st_size == 0 && ftruncate(fd, sizeof(SndCtlSharedStateSegment)) == -1)) {
+		if (error)
+			*error = SndCtlErrorCreateWithPOSIXCode(errno, CFSTR("Couldn't create the shared state segment."));
+
+		if (fd != -1)
+			close(fd);
+
+		return NULL;
+	}
+
+	SndCtlSharedStateSegment *segment = mmap(NULL, sizeof(SndCtlSharedStateSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (segment == MAP_FAILED) {
+		if (error)
+			*error = SndCtlErrorCreateWithPOSIXCode(errno, CFSTR("Couldn't map the shared state segment."));
+
+		return NULL;
+	}
+
+	pid_t pid = (pid_t)segment->snapshot.publisherPID;
+
+	// A stale heartbeat means the publisher is gone even if its PID has been reused since.
+	if (segment->magic == kSndCtlSharedStateMagic && segment->version == kSndCtlSharedStateVersion && pid != 0 && pid != getpid() && SndCtlSharedStateIsLive(segment, &segment->snapshot) && (kill(pid, 0) == 0 || errno == EPERM)) {
+		if (error) {
+			CFStringRef description = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("sndctl is already publishing from process %d."), pid);
+			*error = SndCtlErrorCreateWithPOSIXCode(EBUSY, description);
+			CFRelease(description);
+		}
+
+		munmap(segment, sizeof(SndCtlSharedStateSegment));
+		return NULL;
+	}
+
+	// A publisher that died mid-update leaves the sequence odd, which would stall readers forever.
+	if (segment->sequence & 1)
+		__atomic_store_n(&segment->sequence, segment->sequence + 1, __ATOMIC_RELEASE);
+
+	SndCtlStatePublisherRef publisher = calloc(1, sizeof(struct SndCtlStatePublisher));
+	publisher->refCount = 1;
+	publisher->segment = segment;
+	publisher->published = segment->snapshot;
+
+	return publisher;
+}
+
+static void SndCtlStatePublisherRetain(SndCtlStatePublisherRef publisher) {
+	__atomic_add_fetch(&publisher->refCount, 1, __ATOMIC_RELAXED);
+}
+
+static void SndCtlStatePublisherDrop(void *context) {
+	SndCtlStatePublisherRef publisher = context;
+
+	if (__atomic_sub_fetch(&publisher->refCount, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+
+	// Fine even from a block on the queue, which keeps the queue alive until it returns.
+	if (publisher->queue)
+		dispatch_release(publisher->queue);
+
+	munmap(publisher->segment, sizeof(SndCtlSharedStateSegment));
+	free(publisher->watchedDevices);
+	free(publisher);
+}
+
+static void SndCtlStatePublisherWrite(SndCtlStatePublisherRef publisher, const SndCtlSharedStateSnapshot *snapshot) {
+	SndCtlSharedStateSegment *segment = publisher->segment;
+	uint32_t sequence = segment->sequence;
+
+	// The odd sequence has to be visible before any of the snapshot is.
+	__atomic_store_n(&segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(&segment->snapshot, snapshot, sizeof(SndCtlSharedStateSnapshot));
+
+	__atomic_store_n(&segment->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+	publisher->published = *snapshot;
+}
+
+static bool SndCtlStatePublisherIsWatching(SndCtlStatePublisherRef publisher, AudioObjectID deviceid) {
+	for (CFIndex i = 0; i < publisher->watchedCount; ++i) {
+		if (publisher->watchedDevices[i] == deviceid)
+			return true;
+	}
+
+	return false;
+}
+
+static OSStatus SndCtlStatePublisherListener(AudioObjectID objectid, UInt32 addressCount, const AudioObjectPropertyAddress *addresses, void *clientData);
+
+static void SndCtlStatePublisherSetDeviceListeners(SndCtlStatePublisherRef publisher, AudioObjectID deviceid, bool add) {
+	// Devices without one of the controls just don't get its listener.
+	for (size_t i = 0; i < kSndCtlStatePublisherDeviceAddressCount; ++i) {
+		if (add)
+			SndCtlHALAddPropertyListener(deviceid, &kSndCtlStatePublisherDeviceAddresses[i], SndCtlStatePublisherListener, publisher);
+		else
+			SndCtlHALRemovePropertyListener(deviceid, &kSndCtlStatePublisherDeviceAddresses[i], SndCtlStatePublisherListener, publisher);
+	}
+}
+
+// Moves the per-device listeners to the devices in a table. Pass NULL to remove them all.
+static void SndCtlStatePublisherWatchDevices(SndCtlStatePublisherRef publisher, const SndCtlDeviceTable *table) {
+	CFIndex count = table ? table->count : 0;
+
+	for (CFIndex i = 0; i < publisher->watchedCount; ++i) {
+		AudioObjectID deviceid = publisher->watchedDevices[i];
+		bool stillPresent = false;
+
+		for (CFIndex j = 0; j < count && !stillPresent; ++j)
+			stillPresent = table->devices[j].deviceid == deviceid;
+
+		if (!stillPresent)
+			SndCtlStatePublisherSetDeviceListeners(publisher, deviceid, false);
+	}
+
+	for (CFIndex i = 0; i < count; ++i) {
+		if (!SndCtlStatePublisherIsWatching(publisher, table->devices[i].deviceid))
+			SndCtlStatePublisherSetDeviceListeners(publisher, table->devices[i].deviceid, true);
+	}
+
+	publisher->watchedDevices = realloc(publisher->watchedDevices, (count > 0 ? count : 1) * sizeof(AudioObjectID));
+	publisher->watchedCount = count;
+
+	for (CFIndex i = 0; i < count; ++i)
+		publisher->watchedDevices[i] = table->devices[i].deviceid;
+}
+
+static void SndCtlStatePublisherUpdate(void *context) {
+	SndCtlStatePublisherRef publisher = context;
+
+	// Cleared before reading anything, so a change from here on queues another update.
+	__atomic_store_n(&publisher->updatePending, 0, __ATOMIC_RELEASE);
+
+	if (!publisher->publishing)
+		return;
+
+	SndCtlDeviceTable *table = SndCtlDeviceTableCreate(SndCtlDeviceFieldName | SndCtlDeviceFieldHasMainVolume | SndCtlDeviceFieldHasMainBalance | SndCtlDeviceFieldVolume | SndCtlDeviceFieldBalance, NULL);
+
+	if (!table)
+		return;
+
+	SndCtlSharedStateSnapshot snapshot;
+	memset(&snapshot, 0, sizeof(snapshot));
+	snapshot.publisherPID = (uint32_t)getpid();
+	snapshot.defaultDeviceID = SndCtlDefaultOutputDeviceID(NULL);
+
+	for (CFIndex i = 0; i < table->count && snapshot.deviceCount < kSndCtlSharedStateMaxDevices; ++i) {
+		const SndCtlDeviceInfo *device = &table->devices[i];
+		SndCtlSharedDeviceState *state = &snapshot.devices[snapshot.deviceCount++];
+
+		state->deviceid = device->deviceid;
+
+		if (device->name && strlcpy(state->name, device->name, sizeof(state->name)) >= sizeof(state->name)) {
+			// Don't leave half a character at the end, or readers can't match the name.
+			size_t length = sizeof(state->name) - 1;
+
+			while (length > 0 && ((unsigned char)device->name[length] & 0xc0) == 0x80)
+				--length;
+
+			state->name[length] = '\0';
+		}
+
+		if (device->hasMainVolume && !isnan(device->volume)) {
+			state->flags |= SndCtlSharedDeviceHasVolume;
+			state->volume = device->volume;
+		}
+
+		if (device->hasMainBalance && !isnan(device->balance)) {
+			state->flags |= SndCtlSharedDeviceHasBalance;
+			state->balance = device->balance;
+		}
+
+		UInt32 muted;
+		UInt32 size = sizeof(muted);
+
+		if (SndCtlHALGetPropertyData(device->deviceid, kSndCtlStatePublisherMuteAddress, 0, NULL, &size, &muted) == kAudioHardwareNoError && size == sizeof(muted))
+			state->flags |= SndCtlSharedDeviceHasMute | (muted ? SndCtlSharedDeviceMuted : 0);
+	}
+
+	SndCtlStatePublisherWatchDevices(publisher, table);
+	SndCtlDeviceTableRelease(table);
+
+	// Only publish real changes, so readers can use the generation to skip work.
+	snapshot.generation = publisher->published.generation;
+	snapshot.updated = publisher->published.updated;
+
+	if (memcmp(&snapshot, &publisher->published, sizeof(snapshot)) == 0)
+		return;
+
+	snapshot.generation += 1;
+	snapshot.updated = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+	SndCtlStatePublisherWrite(publisher, &snapshot);
+}
+
+// Runs a queued update and drops the reference the listener took for it.
+static void SndCtlStatePublisherQueuedUpdate(void *context) {
+	SndCtlStatePublisherUpdate(context);
+	SndCtlStatePublisherDrop(context);
+}
+
+static OSStatus SndCtlStatePublisherListener(AudioObjectID objectid, UInt32 addressCount, const AudioObjectPropertyAddress *addresses, void *clientData) {
+	SndCtlStatePublisherRef publisher = clientData;
+
+	// Taken first, so the publisher outlives this call even if it's released meanwhile; handed on
+	// to the update if one is queued.
+	SndCtlStatePublisherRetain(publisher);
+
+	if (__atomic_exchange_n(&publisher->updatePending, 1, __ATOMIC_ACQ_REL) == 0)
+		dispatch_async_f(publisher->queue, publisher, SndCtlStatePublisherQueuedUpdate);
+	else
+		SndCtlStatePublisherDrop(publisher);
+
+	return kAudioHardwareNoError;
+}
+
+static void SndCtlStatePublisherBeat(void *context) {
+	SndCtlStatePublisherRef publisher = context;
+	__atomic_store_n(&publisher->segment->heartbeat, clock_gettime_nsec_np(CLOCK_UPTIME_RAW), __ATOMIC_RELAXED);
+}
+
+static void SndCtlStatePublisherStartOnQueue(void *context) {
+	SndCtlStatePublisherRef publisher = context;
+	SndCtlSharedStateSegment *segment = publisher->segment;
+
+	if (publisher->publishing)
+		return;
+
+	publisher->publishing = true;
+
+	// Beat before the first update, so a reader never sees a fresh snapshot with an old heartbeat.
+	SndCtlStatePublisherBeat(publisher);
+
+	publisher->heartbeatTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, publisher->queue);
+	dispatch_set_context(publisher->heartbeatTimer, publisher);
+	dispatch_source_set_event_handler_f(publisher->heartbeatTimer, SndCtlStatePublisherBeat);
+	dispatch_source_set_timer(publisher->heartbeatTimer, dispatch_time(DISPATCH_TIME_NOW, kSndCtlSharedStateHeartbeatInterval), kSndCtlSharedStateHeartbeatInterval, kSndCtlSharedStateHeartbeatInterval / 10);
+	dispatch_resume(publisher->heartbeatTimer);
+
+	// Force the first update to be written even if it matches what a previous publisher left.
+	publisher->published.publisherPID = 0;
+	SndCtlStatePublisherUpdate(publisher);
+
+	segment->version = kSndCtlSharedStateVersion;
+	__atomic_store_n(&segment->magic, kSndCtlSharedStateMagic, __ATOMIC_RELEASE);
+}
+
+static void SndCtlStatePublisherStopOnQueue(void *context) {
+	SndCtlStatePublisherRef publisher = context;
+
+	if (!publisher->publishing)
+		return;
+
+	publisher->publishing = false;
+	SndCtlStatePublisherWatchDevices(publisher, NULL);
+
+	dispatch_source_cancel(publisher->heartbeatTimer);
+	dispatch_release(publisher->heartbeatTimer);
+	publisher->heartbeatTimer = NULL;
+
+	// Tell readers the state is no longer being kept up to date.
+	SndCtlSharedStateSnapshot snapshot = publisher->published;
+	snapshot.publisherPID = 0;
+	snapshot.generation += 1;
+	snapshot.updated = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+	SndCtlStatePublisherWrite(publisher, &snapshot);
+}
+
+bool SndCtlStatePublisherStart(SndCtlStatePublisherRef publisher, CFErrorRef *error) {
+	if (!publisher->queue)
+		publisher->queue = dispatch_queue_create("org.derailer.sndctl.publisher", DISPATCH_QUEUE_SERIAL);
+
+	// Listen first so nothing between the first snapshot and the listeners is missed.
+	for (size_t i = 0; i < sizeof(kSndCtlStatePublisherSystemAddresses) / sizeof(kSndCtlStatePublisherSystemAddresses[0]); ++i) {
+		OSStatus result = SndCtlHALAddPropertyListener(kAudioObjectSystemObject, &kSndCtlStatePublisherSystemAddresses[i], SndCtlStatePublisherListener, publisher);
+
+		if (result != kAudioHardwareNoError) {
+			while (i-- > 0)
+				SndCtlHALRemovePropertyListener(kAudioObjectSystemObject, &kSndCtlStatePublisherSystemAddresses[i], SndCtlStatePublisherListener, publisher);
+
+			if (error)
+				*error = SndCtlErrorCreateWithOSStatus(result, CFSTR("Couldn't watch for device changes."));
+
+			return false;
+		}
+	}
+
+	dispatch_sync_f(publisher->queue, publisher, SndCtlStatePublisherStartOnQueue);
+
+	return true;
+}
+
+UInt64 SndCtlStatePublisherGetGeneration(SndCtlStatePublisherRef publisher) {
+	SndCtlSharedStateSnapshot snapshot;
+
+	if (!SndCtlSharedStateRead(publisher->segment, &snapshot))
+		return 0;
+
+	return snapshot.generation;
+}
+
+void SndCtlStatePublisherRelease(SndCtlStatePublisherRef publisher) {
+	if (!publisher)
+		return;
+
+	if (publisher->queue) {
+		for (size_t i = 0; i < sizeof(kSndCtlStatePublisherSystemAddresses) / sizeof(kSndCtlStatePublisherSystemAddresses[0]); ++i)
+			SndCtlHALRemovePropertyListener(kAudioObjectSystemObject, &kSndCtlStatePublisherSystemAddresses[i], SndCtlStatePublisherListener, publisher);
+
+		dispatch_sync_f(publisher->queue, publisher, SndCtlStatePublisherStopOnQueue);
+
+		// Drop the owner's reference behind any updates that are already queued.
+		dispatch_async_f(publisher->queue, publisher, SndCtlStatePublisherDrop);
+	} else
+		SndCtlStatePublisherDrop(publisher);
+}
@@ -0,0 +1,53 @@
+//
+//  SndCtlStatePublisher.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlStatePublisher_h
+#define SndCtlStatePublisher_h
+
+#include <stdio.h>
+#include <AudioToolbox/AudioToolbox.h>
+
+/**
+ Publishes the audio state to the shared-memory segment described in \c SndCtlSharedState.h\n.
+ */
+typedef struct SndCtlStatePublisher *SndCtlStatePublisherRef;
+
+/**
+ Create the current user's segment, or take over one left by an earlier publisher.
+ @param error	An error on failure, including when another process is already publishing.
+ @return A new publisher, or \c NULL on failure. Free it with \c SndCtlStatePublisherRelease()\n.
+ @discussion An existing segment is reused rather than replaced, so readers that already have it
+ 	mapped see the new publisher's updates.
+ */
+SndCtlStatePublisherRef SndCtlStatePublisherCreate(CFErrorRef *error);
+
+/**
+ Publish the current state and keep publishing it as it changes.
+ @param publisher	The publisher.
+ @param error		An error on failure.
+ @return Whether the HAL notifications could be registered.
+ @discussion Updates happen on an internal serial queue. A burst of notifications, such as a
+ 	volume slider being dragged, is coalesced into as few updates as the HAL can answer, and the
+ 	generation only changes when something published actually changed.
+ */
+bool SndCtlStatePublisherStart(SndCtlStatePublisherRef publisher, CFErrorRef *error);
+
+/**
+ Get the number of snapshots published so far.
+ */
+UInt64 SndCtlStatePublisherGetGeneration(SndCtlStatePublisherRef publisher);
+
+/**
+ Stop publishing, mark the segment as having no publisher and free the publisher.
+ @discussion The segment itself is left in place for readers that still have it mapped. Nothing is
+ 	published once this returns; the publisher's memory is freed once any notifications already on
+ 	their way have been dropped.
+ */
+void SndCtlStatePublisherRelease(SndCtlStatePublisherRef publisher);
+
+#endif /* SndCtlStatePublisher_h */
@@ -0,0 +1,241 @@
+//
+//  SndCtlSwitch.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlSwitch.h"
+#include "SndCtlAudioUtils.h"
+#include "SndCtlError.h"
+#include "SndCtlHAL.h"
+#include <dispatch/dispatch.h>
+#include <errno.h>
+#include <time.h>
+
+/// How long to wait for the new device's first IO cycle before switching anyway.
+#define kSndCtlSwitchWarmUpTimeout	(2 * NSEC_PER_SEC)
+/// How long to wait for the HAL to report the new default device.
+#define kSndCtlSwitchConfirmTimeout	NSEC_PER_SEC
+/// How often fades set the volume.
+#define kSndCtlSwitchFadeStep		(10 * NSEC_PER_MSEC)
+
+typedef struct {
+	dispatch_semaphore_t started;
+	int signaled;
+} SndCtlSwitchWarmUp;
+
+static const AudioObjectPropertyAddress kSndCtlSwitchDefaultDeviceAddress = {
+	kAudioHardwarePropertyDefaultOutputDevice,
+	kAudioObjectPropertyScopeGlobal,
+	kAudioObjectPropertyElementMaster
+};
+
+static UInt64 SndCtlSwitchNow(void) {
+	return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+static UInt32 SndCtlSwitchGetUInt32(AudioObjectID deviceid, AudioObjectPropertySelector selector, AudioObjectPropertyScope scope) {
+	AudioObjectPropertyAddress address = {
+		selector,
+		scope,
+		kAudioObjectPropertyElementMaster
+	};
+
+	UInt32 value = 0;
+	UInt32 size = sizeof(value);
+
+	if (SndCtlHALGetPropertyData(deviceid, &address, 0, NULL, &size, &value) != kAudioHardwareNoError)
+		return 0;
+
+	return value;
+}
+
+static bool SndCtlSwitchValidate(AudioObjectID deviceid, CFErrorRef *error) {
+	CFStringRef reason = NULL;
+
+	if (!SndCtlSwitchGetUInt32(deviceid, kAudioDevicePropertyDeviceIsAlive, kAudioObjectPropertyScopeGlobal))
+		reason = CFSTR("Device %u isn't alive.");
+	else if (SndCtlNumberOfChannelsOfDeviceID(deviceid, NULL) == 0)
+		reason = CFSTR("Device %u has no outputs.");
+	else if (!SndCtlSwitchGetUInt32(deviceid, kAudioDevicePropertyDeviceCanBeDefaultDevice, kAudioObjectPropertyScopeOutput))
+		reason = CFSTR("Device %u can't be the default output device.");
+
+	if (!reason)
+		return true;
+
+	if (error) {
+		CFStringRef description = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, reason, deviceid);
+		*error = SndCtlErrorCreate(SndCtlErrorDeviceUnavailable, description);
+		CFRelease(description);
+	}
+
+	return false;
+}
+
+// Plays silence, and lets the switch know once the device is actually running.
+static OSStatus SndCtlSwitchWarmUpIOProc(AudioObjectID deviceid, const AudioTimeStamp *now, const AudioBufferList *inputData, const AudioTimeStamp *inputTime, AudioBufferList *outputData, const AudioTimeStamp *outputTime, void *clientData) {
+	SndCtlSwitchWarmUp *warmUp = clientData;
+
+	for (UInt32 i = 0; i < outputData->mNumberBuffers; ++i) {
+		if (outputData->mBuffers[i].mData)
+			memset(outputData->mBuffers[i].mData, 0, outputData->mBuffers[i].mDataByteSize);
+	}
+
+	if (!__atomic_exchange_n(&warmUp->signaled, 1, __ATOMIC_RELAXED))
+		dispatch_semaphore_signal(warmUp->started);
+
+	return kAudioHardwareNoError;
+}
+
+static bool SndCtlSwitchInterrupted(const SndCtlSwitchOptions *options) {
+	return options && options->interrupted && *options->interrupted;
+}
+
+static OSStatus SndCtlSwitchDefaultDeviceListener(AudioObjectID objectid, UInt32 addressCount, const AudioObjectPropertyAddress *addresses, void *clientData) {
+	dispatch_semaphore_signal(clientData);
+	return kAudioHardwareNoError;
+}
+
+// Ramps linearly from one volume to another on a fixed schedule, so slow HAL calls shorten the
+// steps that follow instead of stretching the fade. Stops without reaching `to` if interrupted.
+static void SndCtlSwitchFade(AudioObjectID deviceid, Float32 from, Float32 to, UInt64 duration, const SndCtlSwitchOptions *options) {
+	UInt64 start = SndCtlSwitchNow();
+
+	for (UInt64 elapsed = kSndCtlSwitchFadeStep; elapsed < duration; elapsed += kSndCtlSwitchFadeStep) {
+		if (SndCtlSwitchInterrupted(options))
+			return;
+
+		UInt64 now = SndCtlSwitchNow() - start;
+
+		if (now < elapsed) {
+			struct timespec delay = { 0, (long)(elapsed - now) };
+			nanosleep(&delay, NULL);
+		}
+
+		SndCtlSetVolume(deviceid, from + (to - from) * (Float32)elapsed / (Float32)duration, NULL);
+	}
+
+	SndCtlSetVolume(deviceid, to, NULL);
+}
+
+bool SndCtlSwitchDefaultOutputDevice(AudioObjectID deviceid, const SndCtlSwitchOptions *options, SndCtlSwitchReport *report, CFErrorRef *error) {
+	UInt64 fadeDuration = options ? options->fadeDuration : 0;
+	UInt64 start = SndCtlSwitchNow();
+
+	AudioObjectID previousDeviceID = SndCtlDefaultOutputDeviceID(error);
+
+	if (previousDeviceID == kAudioDeviceUnknown)
+		return false;
+
+	*report = (SndCtlSwitchReport){
+		.previousDeviceID = previousDeviceID,
+		.deviceid = deviceid,
+		.volume = NAN
+	};
+
+	if (!SndCtlSwitchValidate(deviceid, error))
+		return false;
+
+	bool hasVolume = SndCtlOutputDeviceHasMainVolume(deviceid);
+
+	if (deviceid == previousDeviceID) {
+		report->confirmed = true;
+		report->volume = hasVolume ? SndCtlGetVolume(deviceid, NULL) : NAN;
+		report->totalTime = SndCtlSwitchNow() - start;
+		return true;
+	}
+
+	// Replays don't have real devices to start, and nothing is recorded for IO procs anyway.
+	bool live = SndCtlHALGetBackend() != SndCtlHALBackendReplay;
+
+	SndCtlSwitchWarmUp warmUp = { .started = dispatch_semaphore_create(0) };
+	AudioDeviceIOProcID ioProcID = NULL;
+
+	if (live && AudioDeviceCreateIOProcID(deviceid, SndCtlSwitchWarmUpIOProc, &warmUp, &ioProcID) == kAudioHardwareNoError) {
+		if (AudioDeviceStart(deviceid, ioProcID) == kAudioHardwareNoError)
+			report->warmedUp = dispatch_semaphore_wait(warmUp.started, dispatch_time(DISPATCH_TIME_NOW, kSndCtlSwitchWarmUpTimeout)) == 0;
+	}
+
+	bool previousHasVolume = SndCtlOutputDeviceHasMainVolume(previousDeviceID);
+	Float32 previousVolume = previousHasVolume ? SndCtlGetVolume(previousDeviceID, NULL) : NAN;
+	Float32 volume = hasVolume ? SndCtlGetVolume(deviceid, NULL) : NAN;
+
+	report->prepareTime = SndCtlSwitchNow() - start;
+
+	if (fadeDuration) {
+		if (!isnan(volume))
+			SndCtlSetVolume(deviceid, 0.0, NULL);
+		if (!isnan(previousVolume))
+			SndCtlSwitchFade(previousDeviceID, previousVolume, 0.0, fadeDuration, options);
+	}
+
+	// Past this point the switch is finished rather than undone; the restores below still run.
+	bool interrupted = SndCtlSwitchInterrupted(options);
+
+	if (interrupted && error)
+		*error = SndCtlErrorCreateWithPOSIXCode(EINTR, CFSTR("The switch was interrupted."));
+
+	dispatch_semaphore_t changed = dispatch_semaphore_create(0);
+	bool listening = !interrupted && SndCtlHALAddPropertyListener(kAudioObjectSystemObject, &kSndCtlSwitchDefaultDeviceAddress, SndCtlSwitchDefaultDeviceListener, (void *)changed) == kAudioHardwareNoError;
+
+	UInt64 switchStart = SndCtlSwitchNow();
+	bool success = !interrupted && SndCtlSetDefaultOutputDeviceID(deviceid, error);
+
+	if (success) {
+		if (listening && live)
+			report->confirmed = dispatch_semaphore_wait(changed, dispatch_time(DISPATCH_TIME_NOW, kSndCtlSwitchConfirmTimeout)) == 0;
+
+		report->switchTime = SndCtlSwitchNow() - switchStart;
+
+		if (SndCtlDefaultOutputDeviceID(NULL) != deviceid) {
+			if (error) {
+				CFStringRef description = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("Device %u didn't become the default output device."), deviceid);
+				*error = SndCtlErrorCreate(SndCtlErrorDeviceUnavailable, description);
+				CFRelease(description);
+			}
+
+			success = false;
+		}
+	}
+
+	if (listening)
+		SndCtlHALRemovePropertyListener(kAudioObjectSystemObject, &kSndCtlSwitchDefaultDeviceAddress, SndCtlSwitchDefaultDeviceListener, (void *)changed);
+
+	// Some devices reset their volume when they become the default, so put it back if it moved.
+	if (!isnan(volume)) {
+		if (success && fadeDuration) {
+			Float32 current = SndCtlGetVolume(deviceid, NULL);
+			report->volumeRestored = !isnan(current) && current > 0.001;
+			SndCtlSwitchFade(deviceid, 0.0, volume, fadeDuration, options);
+
+			if (SndCtlSwitchInterrupted(options))
+				SndCtlSetVolume(deviceid, volume, NULL);
+		} else {
+			Float32 current = SndCtlGetVolume(deviceid, NULL);
+
+			if (!isnan(current) && fabsf(current - volume) > 0.001) {
+				SndCtlSetVolume(deviceid, volume, NULL);
+				report->volumeRestored = success;
+			}
+		}
+
+		report->volume = volume;
+	}
+
+	if (!isnan(previousVolume))
+		SndCtlSetVolume(previousDeviceID, previousVolume, NULL);
+
+	if (ioProcID) {
+		AudioDeviceStop(deviceid, ioProcID);
+		AudioDeviceDestroyIOProcID(deviceid, ioProcID);
+	}
+
+	dispatch_release(changed);
+	dispatch_release(warmUp.started);
+
+	report->totalTime = SndCtlSwitchNow() - start;
+
+	return success;
+}
@@ -0,0 +1,70 @@
+//
+//  SndCtlSwitch.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlSwitch_h
+#define SndCtlSwitch_h
+
+#include <stdio.h>
+#include <signal.h>
+#include <AudioToolbox/AudioToolbox.h>
+
+/// How to switch.
+typedef struct {
+	/// Nanoseconds to fade the old device out before the switch, and the new device in after it.
+	/// \c 0 switches without fading.
+	UInt64 fadeDuration;
+	/// If set, checked during the switch; once it's non-zero, the switch winds down early. Meant to
+	/// be set from a signal handler. May be \c NULL\n.
+	const volatile sig_atomic_t *interrupted;
+} SndCtlSwitchOptions;
+
+/// What a switch did and how long it took.
+typedef struct {
+	AudioObjectID previousDeviceID;
+	AudioObjectID deviceid;
+	/// Whether the device was running before the switch. If it couldn't be started in time, the
+	/// switch goes ahead cold.
+	bool warmedUp;
+	/// Whether the HAL reported the change, rather than it only being read back afterwards.
+	bool confirmed;
+	/// Nanoseconds spent checking the device and starting it.
+	UInt64 prepareTime;
+	/// Nanoseconds from setting the default device to the HAL reporting the change.
+	UInt64 switchTime;
+	/// Nanoseconds for the whole switch, including fades.
+	UInt64 totalTime;
+	/// The new device's volume after the switch, or \c NAN if it has no main volume.
+	Float32 volume;
+	/// Whether the new device's volume had changed across the switch and was put back.
+	bool volumeRestored;
+} SndCtlSwitchReport;
+
+/**
+ Make a device the default output device with as little of a gap and volume jump as possible.
+ @param deviceid	The new default output device.
+ @param options		How to switch, or \c NULL for the defaults.
+ @param report		Set to what happened, on success.
+ @param error		An error on failure.
+ @return Whether the device is now the default output device.
+ @discussion Unlike \c SndCtlSetDefaultOutputDeviceID()\n, this checks that the device is alive,
+ 	has outputs and can be the default, then starts it playing silence so that it's already running
+ 	when the system moves its output over, instead of starting up in the gap.
+
+ 	With a fade, the old device's volume is ramped down before the switch and the new one's up after
+ 	it. The system only plays to one default device at a time, so this is a fade out and in rather
+ 	than an overlapping crossfade. Either way, each device's own volume is put back afterwards, whether
+ 	it was faded or the device changed it on becoming the default.
+
+ 	If \c options->interrupted becomes non-zero, fades stop where they are and the volumes are put
+ 	back straight away. An interruption before the switch itself cancels it and fails with \c EINTR\n.
+
+ 	Switching to the device that's already the default succeeds without doing anything.
+ */
+bool SndCtlSwitchDefaultOutputDevice(AudioObjectID deviceid, const SndCtlSwitchOptions *options, SndCtlSwitchReport *report, CFErrorRef *error);
+
+#endif /* SndCtlSwitch_h */
@@ -12,7 +12,17 @@
 #import <xlocale.h>
 #import <getopt.h>
 #import <iconv.h>
+#import <dispatch/dispatch.h>
 #import "SndCtlAudioUtils.h"
+#import "SndCtlHAL.h"
+#import "SndCtlDeviceSelector.h"
+#import "SndCtlControlServer.h"
+#import "SndCtlRules.h"
+#import "SndCtlProperty.h"
+#import "SndCtlStatePublisher.h"
+#import "SndCtlSharedState.h"
+#import "SndCtlSwitch.h"
+#import <signal.h>
 
 char *utf8StringCopyFromCFString(CFStringRef string, char *buf, size_t buflen) {
 	const char *cStr = CFStringGetCStringPtr(string, kCFStringEncodingUTF8);
@@ -60,49 +70,193 @@ void SndCtlPrintError(CFErrorRef error, bool release) {
 	CFIndex code = CFErrorGetCode(error);
 	utf8StringCopyFromCFString(localizedDescription, buf, sizeof(buf));
 
-	dprintf(STDERR_FILENO, "%s (%s)\n", buf, SndControlStringFromFourCharCode((FourCharCode)code));
+	if (CFStringCompare(CFErrorGetDomain(error), kCFErrorDomainOSStatus, 0) == kCFCompareEqualTo)
+		dprintf(STDERR_FILENO, "%s (%s)\n", buf, SndControlStringFromFourCharCode((FourCharCode)code));
+	else
+		dprintf(STDERR_FILENO, "%s\n", buf);
 	CFRelease(localizedDescription);
 
 	if (release)
 		CFRelease(error);
 }
 
-void listAudioOutputDevices(void) {
+bool listAudioOutputDevices(void) {
 
 	bool color = getenv("CLICOLOR") != NULL;
 
 	const char * const yesString = color ? "\e[32myes\e[0m" : "yes";
 	const char * const noString = color ? "\e[31mno\e[0m" : "no";
 	CFErrorRef error;
-	CFArrayRef devices = SndCtlCopyAudioOutputDevices(&error);
+	SndCtlDeviceTable *table = SndCtlDeviceTableCreate(SndCtlDeviceFieldName | SndCtlDeviceFieldHasMainVolume | SndCtlDeviceFieldHasMainBalance, &error);
 
-	if (!devices) {
+	if (!table) {
 		SndCtlPrintError(error, true);
-		return;
+		return false;
+	}
+
+	for (CFIndex i = 0; i < table->count; ++i) {
+		const SndCtlDeviceInfo *device = &table->devices[i];
+
+		printf("%d: %s\n", device->deviceid, device->name ? device->name : "");
+
+		if (device->unresponsive) {
+			printf("    %s\n", color ? "\e[33munresponsive\e[0m" : "unresponsive");
+			continue;
+		}
+
+		printf("    has volume:  %s\n", device->hasMainVolume ? yesString : noString);
+		printf("    has balance: %s\n", device->hasMainBalance ? yesString : noString);
+	}
+
+	SndCtlDeviceTableRelease(table);
+
+	return true;
+}
+
+// The column that isn't a device attribute.
+enum {
+	SndCtlListColumnID = 0,
+};
+
+static const struct {
+	const char *name;
+	SndCtlDeviceField field;
+} kSndCtlListColumns[] = {
+	{ "id",				SndCtlListColumnID },
+	{ "status",			SndCtlDeviceFieldStatus },
+	{ "name",			SndCtlDeviceFieldName },
+	{ "uid",			SndCtlDeviceFieldUID },
+	{ "manufacturer",	SndCtlDeviceFieldManufacturer },
+	{ "transport",		SndCtlDeviceFieldTransportType },
+	{ "channels",		SndCtlDeviceFieldChannels },
+	{ "hasvolume",		SndCtlDeviceFieldHasMainVolume },
+	{ "hasbalance",		SndCtlDeviceFieldHasMainBalance },
+	{ "volume",			SndCtlDeviceFieldVolume },
+	{ "balance",		SndCtlDeviceFieldBalance },
+	{ "samplerate",		SndCtlDeviceFieldSampleRate },
+	{ "buffersize",		SndCtlDeviceFieldBufferFrameSize },
+	{ "latency",		SndCtlDeviceFieldLatency },
+};
+
+#define kSndCtlListColumnCount (sizeof(kSndCtlListColumns) / sizeof(kSndCtlListColumns[0]))
+/// The most columns --fields can print.
+#define kSndCtlMaxListColumns 32
+
+static void printListColumn(const SndCtlDeviceInfo *device, SndCtlDeviceField field) {
+	char buf[256] = "-";
+
+	switch (field) {
+		case SndCtlListColumnID:
+			printf("%u", device->deviceid);
+			return;
+		case SndCtlDeviceFieldStatus:
+			printf("%s", device->unresponsive ? "unresponsive" : "ok");
+			return;
+		case SndCtlDeviceFieldName:
+			if (device->name)
+				strlcpy(buf, device->name, sizeof(buf));
+			break;
+		case SndCtlDeviceFieldUID:
+			if (device->uid)
+				strlcpy(buf, device->uid, sizeof(buf));
+			break;
+		case SndCtlDeviceFieldManufacturer:
+			if (device->manufacturer)
+				strlcpy(buf, device->manufacturer, sizeof(buf));
+			break;
+		case SndCtlDeviceFieldTransportType:
+			strlcpy(buf, SndCtlNameForTransportType(device->transportType), sizeof(buf));
+			break;
+		case SndCtlDeviceFieldChannels:
+			snprintf(buf, sizeof(buf), "%u", device->channels);
+			break;
+		case SndCtlDeviceFieldHasMainVolume:
+			strlcpy(buf, device->hasMainVolume ? "yes" : "no", sizeof(buf));
+			break;
+		case SndCtlDeviceFieldHasMainBalance:
+			strlcpy(buf, device->hasMainBalance ? "yes" : "no", sizeof(buf));
+			break;
+		case SndCtlDeviceFieldVolume:
+			if (!isnan(device->volume))
+				snprintf(buf, sizeof(buf), "%.2f", device->volume);
+			break;
+		case SndCtlDeviceFieldBalance:
+			if (!isnan(device->balance))
+				snprintf(buf, sizeof(buf), "%.2f", device->balance);
+			break;
+		case SndCtlDeviceFieldSampleRate:
+			if (device->sampleRate > 0)
+				snprintf(buf, sizeof(buf), "%.0f", device->sampleRate);
+			break;
+		case SndCtlDeviceFieldBufferFrameSize:
+			if (device->bufferFrameSize > 0)
+				snprintf(buf, sizeof(buf), "%u", device->bufferFrameSize);
+			break;
+		case SndCtlDeviceFieldLatency:
+			if (device->latencyFrames > 0)
+				snprintf(buf, sizeof(buf), "%u", device->latencyFrames);
+			break;
+	}
+
+	printf("%s", buf);
+}
+
+// Lists devices as tab-separated columns, fetching only what those columns need.
+bool listAudioOutputDevicesWithFields(const char *fieldList) {
+	SndCtlDeviceField columns[kSndCtlMaxListColumns];
+	size_t columnCount = 0;
+	SndCtlDeviceField fields = 0;
+
+	char *copy = strdup(fieldList);
+	char *cursor = copy;
+	char *fieldName;
+
+	while ((fieldName = strsep(&cursor, ",")) != NULL) {
+		size_t i = 0;
+
+		if (columnCount == kSndCtlMaxListColumns) {
+			dprintf(STDERR_FILENO, "Too many fields. At most %d can be listed.\n", kSndCtlMaxListColumns);
+			free(copy);
+			return false;
+		}
+
+		while (i < kSndCtlListColumnCount && strcasecmp(kSndCtlListColumns[i].name, fieldName) != 0)
+			++i;
+
+		if (i == kSndCtlListColumnCount) {
+			dprintf(STDERR_FILENO, "Unknown field '%s'.\n", fieldName);
+			free(copy);
+			return false;
+		}
+
+		columns[columnCount++] = kSndCtlListColumns[i].field;
+		fields |= kSndCtlListColumns[i].field;
 	}
 
-	CFIndex count = CFArrayGetCount(devices);
+	free(copy);
 
-	for (CFIndex i = 0; i < count; ++i) {
-		CFDictionaryRef device = CFArrayGetValueAtIndex(devices, i);
-		CFNumberRef idval = CFDictionaryGetValue(device, kSndCtlAudioDeviceAttributeID);
-		AudioObjectID id;
-		CFNumberGetValue(idval, kCFNumberSInt32Type, &id);
-		CFStringRef name = CFDictionaryGetValue(device, kSndCtlAudioDeviceAttributeName);
+	CFErrorRef error;
+	SndCtlDeviceTable *table = SndCtlDeviceTableCreate(fields, &error);
 
-		char nameBuffer[256];
+	if (!table) {
+		SndCtlPrintError(error, true);
+		return false;
+	}
 
-		utf8StringCopyFromCFString(name, nameBuffer, sizeof(nameBuffer));
+	for (CFIndex i = 0; i < table->count; ++i) {
+		for (size_t column = 0; column < columnCount; ++column) {
+			if (column > 0)
+				putchar('\t');
 
-		CFBooleanRef hasVolume = CFDictionaryGetValue(device, kSndCtlAudioDeviceAttributeHasMainVolume);
-		CFBooleanRef hasBalance = CFDictionaryGetValue(device, kSndCtlAudioDeviceAttributeHasMainBalance);
+			printListColumn(&table->devices[i], columns[column]);
+		}
 
-		printf("%d: %s\n", id, nameBuffer);
-		printf("    has volume:  %s\n", CFBooleanGetValue(hasVolume) ? yesString : noString);
-		printf("    has balance: %s\n", CFBooleanGetValue(hasBalance) ? yesString : noString);
+		putchar('\n');
 	}
 
-	CFRelease(devices);
+	SndCtlDeviceTableRelease(table);
+
+	return true;
 }
 
 // Counts the codepoints in a UTF-8 string.
@@ -167,41 +321,55 @@ void SndCtlPrintSlider(size_t barWidth, Float32 position, const char *minString,
 	printf("%s%s%s" "%s%s%s" "%s%s%s\n", bold, minString, normal, barLeftCap, barString, barRightCap, bold, maxString, normal);
 }
 
-bool printVolume(AudioObjectID deviceid, bool printAsSlider, CFErrorRef *error) {
-	Float32 volume = SndCtlGetVolume(deviceid, error);
+void printVolume(Float32 volume, bool printAsSlider) {
+	if (printAsSlider)
+		SndCtlPrintSlider(21, volume, "- ", " +");
+	else
+		printf("Volume: %.2f\n", volume);
+}
 
-	if (!isnan(volume)) {
-		if (printAsSlider)
-			SndCtlPrintSlider(21, volume, "- ", " +");
+void printBalance(Float32 balance, bool printAsSlider) {
+	if (printAsSlider) {
+		SndCtlPrintSlider(21, balance, "L ", " R");
+	} else {
+		if (balance == 0.0)
+			printf("Balance: left\n");
+		else if (balance == 0.5)
+			printf("Balance: center\n");
+		else if (balance == 1.0)
+			printf("Balance: right\n");
 		else
-			printf("Volume: %.2f\n", volume);
-		return true;
+			printf("Balance: %.2f\n", balance);
 	}
+}
 
-	return false;
+void printSampleRate(Float64 sampleRate) {
+	printf("Sample rate: %g Hz\n", sampleRate);
 }
 
-bool printBalance(AudioObjectID deviceid, bool printAsSlider, CFErrorRef *error) {
-	Float32 balance = SndCtlGetBalance(deviceid, error);
+void printBufferFrameSize(UInt32 frames) {
+	printf("Buffer size: %u frames\n", frames);
+}
 
-	if (!isnan(balance)) {
-		if (printAsSlider) {
-			SndCtlPrintSlider(21, balance, "L ", " R");
-		} else {
-			if (balance == 0.0)
-				printf("Balance: left\n");
-			else if (balance == 0.5)
-				printf("Balance: center\n");
-			else if (balance == 1.0)
-				printf("Balance: right\n");
-			else
-				printf("Balance: %.2f\n", balance);
-		}
+bool printLatency(AudioObjectID deviceid, CFErrorRef *error) {
+	SndCtlOutputLatency latency;
 
-		return true;
-	}
+	if (!SndCtlGetOutputLatency(deviceid, &latency, error))
+		return false;
+
+	UInt32 total = SndCtlOutputLatencyTotalFrames(&latency);
 
-	return false;
+	printf("Latency: %u frames", total);
+	if (latency.sampleRate > 0)
+		printf(" (%.2f ms)", total * 1000.0 / latency.sampleRate);
+	printf("\n");
+
+	printf("    device:        %u\n", latency.deviceFrames);
+	printf("    stream:        %u\n", latency.streamFrames);
+	printf("    safety offset: %u\n", latency.safetyOffsetFrames);
+	printf("    buffer:        %u\n", latency.bufferFrames);
+
+	return true;
 }
 
 void printVersion(void) {
@@ -233,10 +401,39 @@ void printHelp(void) {
 		 "  -B, --printbalance         Display the current balance.\n"
 		 "  -v, --volume=<volume>      Set the volume from 0.0 (mute) to 1.0 (max).\n"
 		 "  -V, --printvolume          Display the current volume.\n"
+		 "  -r, --samplerate=<rate>    Set the nominal sample rate in Hz.\n"
+		 "  -R, --printsamplerate      Display the nominal sample rate.\n"
+		 "      --buffersize=<frames>  Set the I/O buffer size in frames.\n"
+		 "      --printbuffersize      Display the I/O buffer size.\n"
+		 "      --printlatency         Display the total output latency and its components.\n"
 		 "  -d, --device=<device>      Modify the specified device instead of the default output device.\n"
+		 "                             <device> is an ID, part of a name, or a selector like 'transport=usb,channels>=8'.\n"
 		 "  -D, --default=<device>     Set the default audio device.\n"
+		 "      --switch=<device>      Set the default audio device after checking and starting it, keeping\n"
+		 "                             both devices' volumes, and report how long the switch took.\n"
+		 "      --fade=<ms>            With --switch, fade out over <ms> milliseconds before switching and\n"
+		 "                             back in after. Up to 60000.\n"
 		 "      --visual               Display -V and -B as ASCII sliders.\n"
 		 "  -l, --list                 List available output devices.\n"
+		 "      --fields=<fields>      With -l, print only these comma-separated columns (at most 32):\n"
+		 "                             id, status, name, uid, manufacturer, transport, channels, hasvolume,\n"
+		 "                             hasbalance, volume, balance, samplerate, buffersize, latency.\n"
+		 "      --get=<properties>     Print comma-separated raw properties, each as selector[:scope[:element]].\n"
+		 "                             With -l, print them for every output device.\n"
+		 "      --set=<property>=<value>\n"
+		 "                             Set a raw property of the target device before any --get. Can be repeated.\n"
+		 "      --publish              Keep the current volume, balance and mute of every output device in\n"
+		 "                             shared memory for --peek and other readers.\n"
+		 "      --peek                 Print the volume and balance published by --publish without asking the HAL.\n"
+		 "                             With -l, print every device.\n"
+		 "      --osc=<port>           Accept OSC messages like /sndctl/<device>/volume on a local UDP port.\n"
+		 "      --rules=<file>         Apply the rules in <file> as devices appear or become the default.\n"
+		 "      --timeout=<ms>         Give up on any single device call after <ms> milliseconds.\n"
+		 "      --deadline=<ms>        Give up on all device calls after <ms> milliseconds in total.\n"
+		 "      --verbose              Report the number of HAL calls made.\n"
+		 "      --record=<file>        Record all HAL calls to <file>.\n"
+		 "      --replay=<file>        Answer HAL calls from a recording instead of the hardware.\n"
+		 "      --replay-latency=<x>   Scale recorded call latencies by <x> when replaying (default 1.0).\n"
 		 "  -h, --help                 Display this help.\n"
 		 "  -V, --version              Display version information.\n"
 		 );
@@ -246,53 +443,726 @@ static inline bool isDelta(char *str) {
 	return str && strlen(str) > 1 && (str[0] == '+' || str[0] == '-');
 }
 
-bool SndCtlHandleDeviceMatchingAndPrintErrors(const char *stringToMatch, AudioDeviceID *deviceid) {
-	CFErrorRef error;
-	CFArrayRef matchedDevices = SndCtlCopyAudioDevicesMatchingString(stringToMatch, &error);
+// Picks the one device in a list that matches a selector, or prints why there isn't exactly one.
+static bool SndCtlMatchDeviceAndPrintErrors(SndCtlDeviceSelectorRef selector, const char *stringToMatch, const SndCtlDeviceInfo *devices, CFIndex deviceCount, AudioDeviceID *deviceid) {
+	*deviceid = kAudioDeviceUnknown;
+	CFIndex count = 0;
 
-	if (!matchedDevices) {
-		SndCtlPrintError(error, true);
-		return false;
+	for (CFIndex i = 0; i < deviceCount; ++i) {
+		if (SndCtlDeviceSelectorMatches(selector, &devices[i])) {
+			if (count++ == 0)
+				*deviceid = devices[i].deviceid;
+		}
 	}
 
-	*deviceid = kAudioDeviceUnknown;
-	CFIndex count = CFArrayGetCount(matchedDevices);
-
 	switch (count) {
 		case 0:
 			dprintf(STDERR_FILENO, "'%s' didn't match any devices.\n", stringToMatch);
-			CFRelease(matchedDevices);
-			return false;
 			break;
-		case 1: {
-			CFDictionaryRef device = CFArrayGetValueAtIndex(matchedDevices, 0);
-			CFNumberRef deviceIdRef = CFDictionaryGetValue(device, kSndCtlAudioDeviceAttributeID);
-			CFNumberGetValue(deviceIdRef, kCFNumberSInt32Type, deviceid);
-			CFRelease(matchedDevices);
-			return true;
+		case 1:
 			break;
-		}
 		default:
 			dprintf(STDERR_FILENO, "'%s' matched more than one device:\n", stringToMatch);
 
-			for (CFIndex i = 0; i < count; ++i) {
-				AudioDeviceID iteratedDeviceID;
-				CFDictionaryRef device = CFArrayGetValueAtIndex(matchedDevices, i);
-				CFNumberRef deviceIdRef = CFDictionaryGetValue(device, kSndCtlAudioDeviceAttributeID);
-				CFNumberGetValue(deviceIdRef, kCFNumberSInt32Type, &iteratedDeviceID);
+			for (CFIndex i = 0; i < deviceCount; ++i) {
+				const SndCtlDeviceInfo *device = &devices[i];
 
-				CFStringRef nameRef = CFDictionaryGetValue(device, kSndCtlAudioDeviceAttributeName);
-				char nameStr[256];
-				utf8StringCopyFromCFString(nameRef, nameStr, sizeof(nameStr));
+				if (!SndCtlDeviceSelectorMatches(selector, device))
+					continue;
 
-				dprintf(STDERR_FILENO, "  %s (%u)\n", nameStr, iteratedDeviceID);
+				dprintf(STDERR_FILENO, "  %s (%u)\n", device->name ? device->name : "", device->deviceid);
 			}
+
+			*deviceid = kAudioDeviceUnknown;
 			break;
 	}
 
-	CFRelease(matchedDevices);
+	return count == 1;
+}
+
+bool SndCtlHandleDeviceMatchingAndPrintErrors(const char *stringToMatch, AudioDeviceID *deviceid) {
+	CFErrorRef error;
+	SndCtlDeviceSelectorRef selector = SndCtlDeviceSelectorCreate(stringToMatch, &error);
+
+	if (!selector) {
+		SndCtlPrintError(error, true);
+		return false;
+	}
+
+	SndCtlDeviceTable *table = SndCtlDeviceTableCreate(SndCtlDeviceSelectorRequiredFields(selector) | SndCtlDeviceFieldName, &error);
+
+	if (!table) {
+		SndCtlDeviceSelectorRelease(selector);
+		SndCtlPrintError(error, true);
+		return false;
+	}
+
+	bool matched = SndCtlMatchDeviceAndPrintErrors(selector, stringToMatch, table->devices, table->count, deviceid);
+
+	SndCtlDeviceTableRelease(table);
+	SndCtlDeviceSelectorRelease(selector);
+
+	return matched;
+}
+
+/// What an invocation asked to do to its target device, gathered before any of it is done.
+typedef struct {
+	/// The target device, or \c 0 for the default output device.
+	AudioObjectID deviceid;
+	/// The device just made the default by \c -D\n, if any.
+	AudioObjectID newDefaultDeviceID;
+
+	Float32 balance;
+	bool shouldSetBalance;
+	bool balanceIsDelta;
+
+	Float32 volume;
+	bool shouldSetVolume;
+	bool volumeIsDelta;
+
+	Float64 sampleRate;
+	bool shouldSetSampleRate;
+
+	UInt32 bufferFrameSize;
+	bool shouldSetBufferFrameSize;
+
+	bool shouldPrintBalance;
+	bool shouldPrintVolume;
+	bool shouldPrintSampleRate;
+	bool shouldPrintBufferFrameSize;
+	bool shouldPrintLatency;
+	bool printAsSlider;
+} SndCtlCommandPlan;
+
+static bool SndCtlCommandPlanUsesDevice(const SndCtlCommandPlan *plan) {
+	return plan->shouldSetBalance || plan->shouldSetVolume || plan->shouldSetSampleRate || plan->shouldSetBufferFrameSize
+		|| plan->shouldPrintBalance || plan->shouldPrintVolume || plan->shouldPrintSampleRate || plan->shouldPrintBufferFrameSize || plan->shouldPrintLatency;
+}
+
+// Writes a volume or balance, reading the current value first for deltas. Returns the value written, or NAN on failure.
+static Float32 SndCtlCommandPlanApplyFloat(AudioObjectID deviceid, Float32 value, bool isDelta, Float32 (*get)(AudioObjectID, CFErrorRef *), bool (*set)(AudioObjectID, Float32, CFErrorRef *), CFErrorRef *error) {
+	if (isDelta) {
+		Float32 current = get(deviceid, error);
+
+		if (isnan(current))
+			return NAN;
+
+		value += current;
+	}
+
+	// The HAL clamps too; doing it here means the value can be printed without reading it back.
+	value = fminf(fmaxf(value, 0.0), 1.0);
+
+	return set(deviceid, value, error) ? value : NAN;
+}
+
+/**
+ Runs a plan against its target device.
+ @discussion The default device is looked up at most once, and values that were just written
+ 	are printed as written instead of being read back.
+ */
+static bool SndCtlCommandPlanRun(const SndCtlCommandPlan *plan, CFErrorRef *error) {
+	if (!SndCtlCommandPlanUsesDevice(plan))
+		return true;
+
+	AudioObjectID deviceid = plan->deviceid;
+
+	if (deviceid == kAudioDeviceUnknown)
+		deviceid = plan->newDefaultDeviceID != kAudioDeviceUnknown ? plan->newDefaultDeviceID : SndCtlDefaultOutputDeviceID(error);
+	if (deviceid == kAudioDeviceUnknown)
+		return false;
+
+	Float32 balance = NAN;
+	Float32 volume = NAN;
+	Float64 sampleRate = NAN;
+	UInt32 bufferFrameSize = 0;
+
+	if (plan->shouldSetBalance) {
+		balance = SndCtlCommandPlanApplyFloat(deviceid, plan->balance, plan->balanceIsDelta, SndCtlGetBalance, SndCtlSetBalance, error);
+
+		if (isnan(balance))
+			return false;
+	}
+
+	if (plan->shouldSetVolume) {
+		volume = SndCtlCommandPlanApplyFloat(deviceid, plan->volume, plan->volumeIsDelta, SndCtlGetVolume, SndCtlSetVolume, error);
+
+		if (isnan(volume))
+			return false;
+	}
+
+	if (plan->shouldSetSampleRate) {
+		if (!SndCtlSetNominalSampleRate(deviceid, plan->sampleRate, error))
+			return false;
+
+		sampleRate = plan->sampleRate;
+	}
+
+	if (plan->shouldSetBufferFrameSize) {
+		if (!SndCtlSetBufferFrameSize(deviceid, plan->bufferFrameSize, error))
+			return false;
+
+		bufferFrameSize = plan->bufferFrameSize;
+	}
+
+	if (plan->shouldPrintBalance) {
+		if (isnan(balance))
+			balance = SndCtlGetBalance(deviceid, error);
+		if (isnan(balance))
+			return false;
+
+		printBalance(balance, plan->printAsSlider);
+	}
+
+	if (plan->shouldPrintVolume) {
+		if (isnan(volume))
+			volume = SndCtlGetVolume(deviceid, error);
+		if (isnan(volume))
+			return false;
+
+		printVolume(volume, plan->printAsSlider);
+	}
+
+	if (plan->shouldPrintSampleRate) {
+		if (isnan(sampleRate))
+			sampleRate = SndCtlGetNominalSampleRate(deviceid, error);
+		if (isnan(sampleRate))
+			return false;
+
+		printSampleRate(sampleRate);
+	}
+
+	if (plan->shouldPrintBufferFrameSize) {
+		if (bufferFrameSize == 0)
+			bufferFrameSize = SndCtlGetBufferFrameSize(deviceid, error);
+		if (bufferFrameSize == 0)
+			return false;
+
+		printBufferFrameSize(bufferFrameSize);
+	}
+
+	if (plan->shouldPrintLatency && !printLatency(deviceid, error))
+		return false;
+
+	return true;
+}
+
+static void printHALCallCount(void) {
+	dprintf(STDERR_FILENO, "HAL calls: %llu\n", (unsigned long long)SndCtlHALGetCallCount());
+}
+
+static SndCtlControlServerRef gControlServer = NULL;
 
-	return false;
+static void SndCtlStopControlServer(int signal) {
+	SndCtlControlServerStop(gControlServer);
+}
+
+// Runs the OSC server in the foreground until interrupted.
+bool runControlServer(const char *portString) {
+	char *endptr;
+	unsigned long port = strtoul(portString, &endptr, 10);
+
+	if (*endptr != '\0' || port == 0 || port > UINT16_MAX) {
+		dprintf(STDERR_FILENO, "Invalid port '%s'.\n", portString);
+		return false;
+	}
+
+	CFErrorRef error;
+	gControlServer = SndCtlControlServerCreate((UInt16)port, &error);
+
+	if (!gControlServer) {
+		SndCtlPrintError(error, true);
+		return false;
+	}
+
+	struct sigaction action = { .sa_handler = SndCtlStopControlServer };
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	printf("Listening for OSC on 127.0.0.1:%lu. Press Ctrl-C to stop.\n", port);
+	fflush(stdout);
+
+	SndCtlControlServerRun(gControlServer);
+
+	SndCtlControlServerStatistics statistics = SndCtlControlServerGetStatistics(gControlServer);
+	printf("%llu messages, %llu writes (%llu failed), %llu ignored, %llu rejected, %llu dropped.\n",
+		   statistics.messagesReceived, statistics.writes, statistics.writesFailed, statistics.messagesIgnored, statistics.messagesRejected, statistics.messagesDropped);
+
+	SndCtlControlServerRelease(gControlServer);
+	gControlServer = NULL;
+
+	return true;
+}
+
+// Splits a comma-separated --get argument into requests. The strings are kept until exit.
+static bool SndCtlParsePropertyRequests(const char *list, SndCtlPropertyRequest **requests, size_t *count) {
+	char *cursor = strdup(list);
+	char *string;
+
+	while ((string = strsep(&cursor, ",")) != NULL) {
+		*requests = realloc(*requests, (*count + 1) * sizeof(SndCtlPropertyRequest));
+		CFErrorRef error;
+
+		if (!SndCtlPropertyRequestParse(string, &(*requests)[*count], &error)) {
+			SndCtlPrintError(error, true);
+			return false;
+		}
+
+		++*count;
+	}
+
+	return true;
+}
+
+/**
+ Sets and then gets raw properties of one device, or gets them for every output device.
+ @return Whether every set succeeded.
+ @discussion Prints one tab-separated line per device and property: the device ID, the property as
+ 	requested, its type and its value, or \c error and the status for properties that couldn't be read
+ 	or set. A failed set doesn't stop the others. \c main() refuses sets with \c allDevices\n.
+ */
+bool runPropertyQuery(AudioObjectID deviceid, bool allDevices, const SndCtlPropertyRequest *gets, size_t getCount, const SndCtlPropertyRequest *sets, char * const *setValues, size_t setCount) {
+	CFErrorRef error;
+	AudioObjectID *deviceids;
+	size_t deviceCount;
+
+	if (allDevices) {
+		SndCtlDeviceTable *table = SndCtlDeviceTableCreate(0, &error);
+
+		if (!table) {
+			SndCtlPrintError(error, true);
+			return false;
+		}
+
+		deviceCount = table->count;
+		deviceids = malloc((deviceCount + 1) * sizeof(AudioObjectID));
+
+		for (CFIndex i = 0; i < table->count; ++i)
+			deviceids[i] = table->devices[i].deviceid;
+
+		SndCtlDeviceTableRelease(table);
+	} else {
+		if (deviceid == kAudioDeviceUnknown)
+			deviceid = SndCtlDefaultOutputDeviceID(&error);
+
+		if (deviceid == kAudioDeviceUnknown) {
+			SndCtlPrintError(error, true);
+			return false;
+		}
+
+		deviceCount = 1;
+		deviceids = malloc(sizeof(AudioObjectID));
+		deviceids[0] = deviceid;
+	}
+
+	bool setsSucceeded = true;
+
+	for (size_t i = 0; i < deviceCount; ++i) {
+		for (size_t j = 0; j < setCount; ++j) {
+			if (SndCtlPropertySetValue(deviceids[i], &sets[j], setValues[j], &error))
+				continue;
+
+			setsSucceeded = false;
+
+			// HAL failures are reported like failed gets; bad values aren't the device's fault.
+			if (CFStringCompare(CFErrorGetDomain(error), kCFErrorDomainOSStatus, 0) == kCFCompareEqualTo) {
+				printf("%u\t%s\terror\t%s\n", deviceids[i], sets[j].string, SndControlStringFromFourCharCode((FourCharCode)CFErrorGetCode(error)));
+				CFRelease(error);
+			} else
+				SndCtlPrintError(error, true);
+		}
+	}
+
+	SndCtlPropertyResult *results = SndCtlPropertyCopyValues(deviceids, deviceCount, gets, getCount);
+
+	for (size_t i = 0; i < deviceCount; ++i) {
+		for (size_t j = 0; j < getCount; ++j) {
+			const SndCtlPropertyResult *result = &results[i * getCount + j];
+
+			if (result->status == kAudioHardwareNoError)
+				printf("%u\t%s\t%s\t%s\n", deviceids[i], gets[j].string, SndCtlNameForPropertyType(result->type), result->value);
+			else
+				printf("%u\t%s\terror\t%s\n", deviceids[i], gets[j].string, SndControlStringFromFourCharCode((FourCharCode)result->status));
+		}
+	}
+
+	SndCtlPropertyResultsRelease(results, deviceCount * getCount);
+	free(deviceids);
+
+	return setsSucceeded;
+}
+
+static void printRuleReport(const SndCtlRuleReport *report, void *context) {
+	const char *event = report->trigger == SndCtlRuleTriggerAppears ? "appeared" : "became default";
+	double milliseconds = (double)report->reactionTime / NSEC_PER_MSEC;
+
+	if (report->success)
+		printf("[line %u] '%s' %s: %s (%u), applied in %.1f ms.\n", report->line, report->selector, event, report->deviceName ?: "?", report->deviceid, milliseconds);
+	else {
+		printf("[line %u] '%s' %s: %s (%u), failed after %.1f ms.\n", report->line, report->selector, event, report->deviceName ?: "?", report->deviceid, milliseconds);
+
+		if (report->error)
+			SndCtlPrintError(report->error, false);
+	}
+
+	fflush(stdout);
+}
+
+// Applies a rules file in the foreground until interrupted.
+bool runRules(const char *path) {
+	CFErrorRef error;
+	SndCtlRuleSetRef rules = SndCtlRuleSetCreateWithFile(path, &error);
+
+	if (!rules) {
+		SndCtlPrintError(error, true);
+		return false;
+	}
+
+	// Blocked before the rules' queue starts any threads so that only sigwait() sees them.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+	if (!SndCtlRuleSetStartMonitoring(rules, printRuleReport, NULL, &error)) {
+		SndCtlPrintError(error, true);
+		SndCtlRuleSetRelease(rules);
+		return false;
+	}
+
+	size_t count = SndCtlRuleSetGetCount(rules);
+	printf("Watching %zu rule%s from %s. Press Ctrl-C to stop.\n", count, count == 1 ? "" : "s", path);
+	fflush(stdout);
+
+	int received;
+	sigwait(&signals, &received);
+
+	SndCtlRuleSetRelease(rules);
+
+	return true;
+}
+
+// Publishes the audio state in the foreground until interrupted.
+bool runStatePublisher(void) {
+	CFErrorRef error;
+	SndCtlStatePublisherRef publisher = SndCtlStatePublisherCreate(&error);
+
+	if (!publisher) {
+		SndCtlPrintError(error, true);
+		return false;
+	}
+
+	// Blocked before the publisher's queue starts any threads so that only sigwait() sees them.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+	if (!SndCtlStatePublisherStart(publisher, &error)) {
+		SndCtlPrintError(error, true);
+		SndCtlStatePublisherRelease(publisher);
+		return false;
+	}
+
+	char name[32];
+	SndCtlSharedStateGetName(name, sizeof(name));
+	printf("Publishing audio state to %s. Press Ctrl-C to stop.\n", name);
+	fflush(stdout);
+
+	int received;
+	sigwait(&signals, &received);
+
+	printf("Published generation %llu.\n", SndCtlStatePublisherGetGeneration(publisher));
+	SndCtlStatePublisherRelease(publisher);
+
+	return true;
+}
+
+static void printPeekedFloat(uint32_t flags, uint32_t flag, float value) {
+	if (flags & flag)
+		printf("\t%.2f", value);
+	else
+		fputs("\t-", stdout);
+}
+
+/// The attributes a published snapshot has for matching \c -d selectors.
+static const SndCtlDeviceField kSndCtlPeekFields = SndCtlDeviceFieldName | SndCtlDeviceFieldFoldedStrings | SndCtlDeviceFieldHasMainVolume | SndCtlDeviceFieldHasMainBalance;
+
+/**
+ Like \c SndCtlHandleDeviceMatchingAndPrintErrors()\n, but matches against the devices in a published
+ snapshot instead of asking the HAL.
+ */
+static bool SndCtlHandlePeekedDeviceMatchingAndPrintErrors(const char *stringToMatch, const SndCtlSharedStateSnapshot *snapshot, AudioDeviceID *deviceid) {
+	CFErrorRef error;
+	SndCtlDeviceSelectorRef selector = SndCtlDeviceSelectorCreate(stringToMatch, &error);
+
+	if (!selector) {
+		SndCtlPrintError(error, true);
+		return false;
+	}
+
+	if (SndCtlDeviceSelectorRequiredFields(selector) & ~kSndCtlPeekFields) {
+		dprintf(STDERR_FILENO, "With --peek, devices can only be picked by id, name or has.\n");
+		SndCtlDeviceSelectorRelease(selector);
+		return false;
+	}
+
+	uint32_t count = snapshot->deviceCount < kSndCtlSharedStateMaxDevices ? snapshot->deviceCount : kSndCtlSharedStateMaxDevices;
+	SndCtlDeviceInfo devices[kSndCtlSharedStateMaxDevices];
+
+	for (uint32_t i = 0; i < count; ++i) {
+		const SndCtlSharedDeviceState *state = &snapshot->devices[i];
+
+		devices[i] = (SndCtlDeviceInfo){
+			.deviceid = state->deviceid,
+			.fields = kSndCtlPeekFields,
+			.name = state->name,
+			.foldedName = SndCtlCopyFoldedString(state->name),
+			.hasMainVolume = (state->flags & SndCtlSharedDeviceHasVolume) != 0,
+			.hasMainBalance = (state->flags & SndCtlSharedDeviceHasBalance) != 0,
+		};
+	}
+
+	bool matched = SndCtlMatchDeviceAndPrintErrors(selector, stringToMatch, devices, count, deviceid);
+
+	for (uint32_t i = 0; i < count; ++i)
+		free((char *)devices[i].foldedName);
+
+	SndCtlDeviceSelectorRelease(selector);
+
+	return matched;
+}
+
+/**
+ Prints published state without any HAL calls.
+ @param deviceid		The target device, or \c kAudioDeviceUnknown for the default device.
+ @param deviceSelector	A \c -d selector to match against the published device names instead, or \c NULL\n.
+ @discussion Prints the target device like \c -V \c -B\n, or with \c all a tab-separated line per device:
+ 	ID, whether it's the default, volume, balance, mute and name.
+ */
+bool peekSharedState(AudioObjectID deviceid, const char *deviceSelector, bool all, bool printAsSlider) {
+	const SndCtlSharedStateSegment *segment = SndCtlSharedStateMap();
+
+	if (!segment) {
+		if (errno == ENOENT)
+			dprintf(STDERR_FILENO, "No audio state has been published. Run sndctl --publish first.\n");
+		else
+			dprintf(STDERR_FILENO, "Couldn't read the published audio state: %s\n", strerror(errno));
+
+		return false;
+	}
+
+	SndCtlSharedStateSnapshot snapshot;
+	bool read = SndCtlSharedStateRead(segment, &snapshot);
+	bool live = read && SndCtlSharedStateIsLive(segment, &snapshot);
+	SndCtlSharedStateUnmap(segment);
+
+	if (!read) {
+		dprintf(STDERR_FILENO, "The published audio state is being updated too often to read.\n");
+		return false;
+	}
+
+	// The heartbeat catches a publisher that was killed within a few seconds; kill() catches it right away.
+	if (!live || (kill((pid_t)snapshot.publisherPID, 0) == -1 && errno == ESRCH)) {
+		dprintf(STDERR_FILENO, "The audio state is no longer being published. Run sndctl --publish first.\n");
+		return false;
+	}
+
+	if (all) {
+		for (uint32_t i = 0; i < snapshot.deviceCount; ++i) {
+			const SndCtlSharedDeviceState *device = &snapshot.devices[i];
+
+			printf("%u\t%s", device->deviceid, device->deviceid == snapshot.defaultDeviceID ? "default" : "-");
+			printPeekedFloat(device->flags, SndCtlSharedDeviceHasVolume, device->volume);
+			printPeekedFloat(device->flags, SndCtlSharedDeviceHasBalance, device->balance);
+			printf("\t%s\t%s\n", !(device->flags & SndCtlSharedDeviceHasMute) ? "-" : (device->flags & SndCtlSharedDeviceMuted) ? "muted" : "unmuted", device->name);
+		}
+
+		return true;
+	}
+
+	if (deviceSelector && !SndCtlHandlePeekedDeviceMatchingAndPrintErrors(deviceSelector, &snapshot, &deviceid))
+		return false;
+
+	if (deviceid == kAudioDeviceUnknown)
+		deviceid = snapshot.defaultDeviceID;
+
+	const SndCtlSharedDeviceState *device = SndCtlSharedStateFindDevice(&snapshot, deviceid);
+
+	if (!device) {
+		dprintf(STDERR_FILENO, "Device %u isn't in the published audio state.\n", deviceid);
+		return false;
+	}
+
+	if (device->flags & SndCtlSharedDeviceHasVolume)
+		printVolume(device->volume, printAsSlider);
+	if (device->flags & SndCtlSharedDeviceHasBalance)
+		printBalance(device->balance, printAsSlider);
+	if (device->flags & SndCtlSharedDeviceHasMute)
+		printf("Muted: %s\n", device->flags & SndCtlSharedDeviceMuted ? "yes" : "no");
+
+	return true;
+}
+
+/// The signal that interrupted a switch, or \c 0\n.
+static volatile sig_atomic_t gSwitchInterruptSignal = 0;
+
+static void handleSwitchInterrupt(int signal) {
+	gSwitchInterruptSignal = signal;
+}
+
+/**
+ Switches the default output device with \c SndCtlSwitchDefaultOutputDevice() and reports the timing.
+ */
+bool switchDefaultOutputDevice(AudioObjectID deviceid, UInt64 fadeDuration) {
+	SndCtlSwitchOptions options = { .fadeDuration = fadeDuration, .interrupted = &gSwitchInterruptSignal };
+	SndCtlSwitchReport report;
+	CFErrorRef error;
+
+	// Blocking the signals wouldn't keep them from the HAL's threads, so catch them instead, let the
+	// switch put the volumes back, then die of the signal as usual.
+	static const int signals[] = { SIGINT, SIGTERM, SIGHUP };
+	struct sigaction previousActions[sizeof(signals) / sizeof(signals[0])];
+	struct sigaction action = { .sa_handler = handleSwitchInterrupt };
+	sigemptyset(&action.sa_mask);
+
+	for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); ++i) {
+		sigaction(signals[i], NULL, &previousActions[i]);
+
+		// Leave ignored signals ignored, e.g. SIGHUP under nohup.
+		if (previousActions[i].sa_handler != SIG_IGN)
+			sigaction(signals[i], &action, NULL);
+	}
+
+	bool switched = SndCtlSwitchDefaultOutputDevice(deviceid, &options, &report, &error);
+
+	for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); ++i)
+		sigaction(signals[i], &previousActions[i], NULL);
+
+	if (gSwitchInterruptSignal)
+		raise(gSwitchInterruptSignal);
+
+	if (!switched) {
+		SndCtlPrintError(error, true);
+		return false;
+	}
+
+	if (report.previousDeviceID == report.deviceid) {
+		printf("Device %u is already the default output device.\n", report.deviceid);
+		return true;
+	}
+
+	printf("Switched from %u to %u in %.1f ms (prepared in %.1f ms, %.1f ms total).\n", report.previousDeviceID, report.deviceid, (double)report.switchTime / NSEC_PER_MSEC, (double)report.prepareTime / NSEC_PER_MSEC, (double)report.totalTime / NSEC_PER_MSEC);
+
+	if (!report.warmedUp)
+		printf("Device %u couldn't be started beforehand, so there may have been a gap.\n", report.deviceid);
+	if (!report.confirmed)
+		printf("The switch wasn't confirmed by a notification; the time is until it was read back.\n");
+	if (report.volumeRestored)
+		printf("Restored the volume of device %u to %.2f.\n", report.deviceid, report.volume);
+
+	return true;
+}
+
+static const char * const kSndCtlShortOptions = "b:Bv:Vr:Rd:D:hl";
+
+/// The longest \c --fade\n, in milliseconds.
+static const double kSndCtlMaxFadeMilliseconds = 60000.0;
+
+/// The longest --timeout or --deadline, well short of overflowing a \c UInt64 of nanoseconds.
+static const double kSndCtlMaxHALMilliseconds = 86400000.0;
+
+// Parses a --timeout or --deadline, which must be above zero since zero means no limit.
+static bool parseHALMilliseconds(const char *option, const char *argument, UInt64 *nanoseconds) {
+	char *endptr;
+	double milliseconds = strtod_l(argument, &endptr, NULL); // Always use the C locale.
+
+	// Written so NaN fails too.
+	if (endptr == argument || *endptr != '\0' || !(milliseconds > 0.0 && milliseconds <= kSndCtlMaxHALMilliseconds)
+		|| (*nanoseconds = (UInt64)(milliseconds * NSEC_PER_MSEC)) == 0) {
+		dprintf(STDERR_FILENO, "Invalid argument '%s' to option '%s'. Expected milliseconds above 0, up to %.0f.\n", argument, option, kSndCtlMaxHALMilliseconds);
+		return false;
+	}
+
+	return true;
+}
+
+// Sets up recording/replay, deadlines and call counting before any other option touches the HAL.
+bool SndCtlHandleHALOptions(int argc, const char * argv[], const struct option *longopts) {
+	const char *recordPath = NULL;
+	const char *replayPath = NULL;
+	double latencyScale = 1.0;
+	UInt64 nanoseconds;
+	int opt;
+
+	opterr = 0;
+
+	while ((opt = getopt_long(argc, (char * const *)argv, kSndCtlShortOptions, longopts, NULL)) != -1) {
+		switch (opt) {
+			case 'rec ':
+				recordPath = optarg;
+				break;
+			case 'rply':
+				replayPath = optarg;
+				break;
+			case 'rlat': {
+				char *endptr;
+				latencyScale = strtod_l(optarg, &endptr, NULL); // Always use the C locale.
+
+				// Written so NaN fails too.
+				if (endptr == optarg || *endptr != '\0' || !(latencyScale >= 0.0 && isfinite(latencyScale))) {
+					dprintf(STDERR_FILENO, "Invalid argument '%s' to option 'replay-latency'. Expected a scale of 0 or more.\n", optarg);
+					return false;
+				}
+
+				break;
+			}
+			case 'tmou':
+				if (!parseHALMilliseconds("timeout", optarg, &nanoseconds))
+					return false;
+
+				SndCtlHALSetCallTimeout(nanoseconds);
+				break;
+			case 'dead':
+				if (!parseHALMilliseconds("deadline", optarg, &nanoseconds))
+					return false;
+
+				SndCtlHALSetDeadline(nanoseconds);
+				break;
+			case 'verb':
+				atexit(printHALCallCount);
+				break;
+		}
+	}
+
+	opterr = 1;
+	optreset = 1;
+	optind = 1;
+
+	if (recordPath && replayPath) {
+		dprintf(STDERR_FILENO, "--record and --replay can't be used together.\n");
+		return false;
+	}
+
+	CFErrorRef error;
+
+	if (recordPath && !SndCtlHALStartRecording(recordPath, &error)) {
+		SndCtlPrintError(error, true);
+		return false;
+	}
+
+	if (replayPath && !SndCtlHALStartReplay(replayPath, latencyScale, &error)) {
+		SndCtlPrintError(error, true);
+		return false;
+	}
+
+	if (recordPath || replayPath)
+		atexit(SndCtlHALStop);
+
+	return true;
 }
 
 int main(int argc, const char * argv[]) {
@@ -301,114 +1171,201 @@ int main(int argc, const char * argv[]) {
 		{ "printbalance",	no_argument,		NULL,	'B' },
 		{ "volume",			required_argument,	NULL,	'v' },
 		{ "printvolume",	no_argument,		NULL,	'V' },
+		{ "samplerate",		required_argument,	NULL,	'r' },
+		{ "printsamplerate",	no_argument,	NULL,	'R' },
+		{ "buffersize",		required_argument,	NULL,	'bufs' },
+		{ "printbuffersize",	no_argument,	NULL,	'pbuf' },
+		{ "printlatency",	no_argument,		NULL,	'plat' },
 		{ "default",		required_argument,	NULL,	'D' },
 		{ "device",			required_argument,	NULL,	'd' },
+		{ "switch",			required_argument,	NULL,	'swch' },
+		{ "fade",			required_argument,	NULL,	'fade' },
 
 		{ "visual", 		no_argument,		NULL,	'visu' },
 
 		{ "help",			no_argument,		NULL,	'h' },
 		{ "list",			no_argument,		NULL,	'l' },
+		{ "fields",			required_argument,	NULL,	'flds' },
+		{ "get",			required_argument,	NULL,	'get ' },
+		{ "set",			required_argument,	NULL,	'set ' },
+		{ "osc",			required_argument,	NULL,	'osc ' },
+		{ "rules",			required_argument,	NULL,	'rule' },
+		{ "publish",		no_argument,		NULL,	'publ' },
+		{ "peek",			no_argument,		NULL,	'peek' },
 		{ "version",		no_argument,		NULL,	'vers' },
+
+		{ "record",			required_argument,	NULL,	'rec ' },
+		{ "replay",			required_argument,	NULL,	'rply' },
+		{ "replay-latency",	required_argument,	NULL,	'rlat' },
+		{ "timeout",		required_argument,	NULL,	'tmou' },
+		{ "deadline",		required_argument,	NULL,	'dead' },
+		{ "verbose",		no_argument,		NULL,	'verb' },
 		{ NULL,				0,					NULL,	0 }
 	};
 
 	int opt;
-	AudioObjectID deviceid = 0;
-
-	Float32 balance = 0.5;
-	bool shouldSetBalance = false;
-
-	Float32 volume = 0.0;
-	bool shouldSetVolume = false;
+	SndCtlCommandPlan plan = {
+		.deviceid = kAudioDeviceUnknown,
+		.newDefaultDeviceID = kAudioDeviceUnknown,
+		.balance = 0.5,
+	};
 
 	bool shouldPrintUsage = true;
 
-	bool shouldPrintVolume = false;
-	bool shouldPrintBalance = false;
-	bool balanceIsDelta = false;
-	bool volumeIsDelta = false;
-
 	CFErrorRef error = NULL;
 
-	bool printAsSlider = false;
+	bool shouldList = false;
+	const char *oscPort = NULL;
+	const char *rulesPath = NULL;
+	bool shouldPublish = false;
+	bool shouldPeek = false;
+	/// A \c -d argument that isn't an ID, resolved once all the options are known.
+	const char *deviceSelector = NULL;
+	AudioObjectID switchDeviceID = kAudioDeviceUnknown;
+	UInt64 fadeDuration = 0;
+	bool shouldFade = false;
+	const char *listFields = NULL;
+
+	SndCtlPropertyRequest *propertyGets = NULL;
+	size_t propertyGetCount = 0;
+	SndCtlPropertyRequest *propertySets = NULL;
+	char **propertySetValues = NULL;
+	size_t propertySetCount = 0;
+
+	if (!SndCtlHandleHALOptions(argc, argv, longopts))
+		return 1;
 
-	while ((opt = getopt_long(argc, (char * const *)argv, "b:Bv:Vd:D:hl", longopts, NULL)) != -1) {
+	while ((opt = getopt_long(argc, (char * const *)argv, kSndCtlShortOptions, longopts, NULL)) != -1) {
 		switch (opt) {
 			case 'b': {
-				shouldSetBalance = true;
+				plan.shouldSetBalance = true;
 				shouldPrintUsage = false;
 
-				balanceIsDelta = isDelta(optarg);
+				plan.balanceIsDelta = isDelta(optarg);
 
 				char *endptr;
-				balance = strtof_l(optarg, &endptr, NULL); // Always use the C locale.
+				plan.balance = strtof_l(optarg, &endptr, NULL); // Always use the C locale.
 
 				// Balance synonyms.
-				if (balance == 0.0 && endptr && endptr == optarg) {
+				if (plan.balance == 0.0 && endptr && endptr == optarg) {
 					if (strlen(endptr) != 0) {
 						switch(endptr[0]) {
 							case 'l':
 							case 'L':
-								balance = 0.0;
+								plan.balance = 0.0;
 								break;
 							case 'r':
 							case 'R':
-								balance = 1.0;
+								plan.balance = 1.0;
 								break;
 							case 'c':
 							case 'C':
-								balance = 0.5;
+								plan.balance = 0.5;
 								break;
 							default:
 								dprintf(STDERR_FILENO, "Invalid argument '%s' to option 'balance'.\n", endptr);
-								shouldSetBalance = false;
+								plan.shouldSetBalance = false;
 								break;
 						}
 					} else
-						balance = 0.5;
+						plan.balance = 0.5;
 				}
 
 				break;
 			}
 			case 'B': {
-				shouldPrintBalance = true;
+				plan.shouldPrintBalance = true;
 				shouldPrintUsage = false;
 				break;
 			}
 			case 'v': {
-				shouldSetVolume = true;
+				plan.shouldSetVolume = true;
 				shouldPrintUsage = false;
 
-				volumeIsDelta = isDelta(optarg);
+				plan.volumeIsDelta = isDelta(optarg);
 
 				char *endptr;
-				volume = strtof_l(optarg, &endptr, NULL); // Always use the C locale.
+				plan.volume = strtof_l(optarg, &endptr, NULL); // Always use the C locale.
 
 				break;
 			}
 			case 'V': {
-				shouldPrintVolume = true;
+				plan.shouldPrintVolume = true;
 				shouldPrintUsage = false;
 				break;
 			}
+			case 'r':
+				plan.shouldSetSampleRate = true;
+				shouldPrintUsage = false;
+				plan.sampleRate = strtod_l(optarg, NULL, NULL); // Always use the C locale.
+				break;
+			case 'R':
+				plan.shouldPrintSampleRate = true;
+				shouldPrintUsage = false;
+				break;
+			case 'bufs':
+				plan.shouldSetBufferFrameSize = true;
+				shouldPrintUsage = false;
+				plan.bufferFrameSize = (UInt32)strtoul(optarg, NULL, 10);
+				break;
+			case 'pbuf':
+				plan.shouldPrintBufferFrameSize = true;
+				shouldPrintUsage = false;
+				break;
+			case 'plat':
+				plan.shouldPrintLatency = true;
+				shouldPrintUsage = false;
+				break;
 			case 'h':
 				printHelp();
 				return 0;
 				break;
 			case 'l':
-				listAudioOutputDevices();
-				return 0;
+				shouldList = true;
 				break;
-			case 'd':
-				deviceid = (AudioObjectID)strtoul(optarg, NULL, 10);
+			case 'flds':
+				listFields = optarg;
+				break;
+			case 'get ':
+				if (!SndCtlParsePropertyRequests(optarg, &propertyGets, &propertyGetCount))
+					return 1;
 
-				if (deviceid == 0 && errno == EINVAL) {
-					if (SndCtlHandleDeviceMatchingAndPrintErrors(optarg, &deviceid))
-						printf("Using device id %u.\n", deviceid);
-					else
-						return 1;
+				break;
+			case 'set ': {
+				char *value = strchr(optarg, '=');
+
+				if (!value) {
+					dprintf(STDERR_FILENO, "Expected <property>=<value>, got '%s'.\n", optarg);
+					return 1;
 				}
 
+				*value++ = '\0';
+				propertySets = realloc(propertySets, (propertySetCount + 1) * sizeof(SndCtlPropertyRequest));
+				propertySetValues = realloc(propertySetValues, (propertySetCount + 1) * sizeof(char *));
+
+				if (!SndCtlPropertyRequestParse(optarg, &propertySets[propertySetCount], &error)) {
+					SndCtlPrintError(error, true);
+					return 1;
+				}
+
+				propertySetValues[propertySetCount++] = value;
+				break;
+			}
+			case 'osc ':
+				oscPort = optarg;
+				break;
+			case 'rule':
+				rulesPath = optarg;
+				break;
+			case 'publ':
+				shouldPublish = true;
+				break;
+			case 'peek':
+				shouldPeek = true;
+				break;
+			case 'd':
+				plan.deviceid = (AudioObjectID)strtoul(optarg, NULL, 10);
+				deviceSelector = plan.deviceid == 0 && errno == EINVAL ? optarg : NULL;
 				break;
 			case 'D': {
 				shouldPrintUsage = false;
@@ -420,7 +1377,32 @@ int main(int argc, const char * argv[]) {
 				}
 
 				printf("Setting default device id to %u.\n", newDefaultId);
-				SndCtlSetDefaultOutputDeviceID(newDefaultId, &error);
+				if (SndCtlSetDefaultOutputDeviceID(newDefaultId, &error))
+					plan.newDefaultDeviceID = newDefaultId;
+				break;
+			}
+			case 'swch':
+				shouldPrintUsage = false;
+				switchDeviceID = (AudioObjectID)strtoul(optarg, NULL, 10);
+
+				if (switchDeviceID == 0 && errno == EINVAL) {
+					if (!SndCtlHandleDeviceMatchingAndPrintErrors(optarg, &switchDeviceID))
+						return 1;
+				}
+
+				break;
+			case 'fade': {
+				char *endptr;
+				double milliseconds = strtod_l(optarg, &endptr, NULL); // Always use the C locale.
+
+				// Written so NaN fails too; the limit keeps the conversion to nanoseconds in range.
+				if (endptr == optarg || *endptr != '\0' || !(milliseconds >= 0.0 && milliseconds <= kSndCtlMaxFadeMilliseconds)) {
+					dprintf(STDERR_FILENO, "Invalid argument '%s' to option 'fade'. Expected milliseconds from 0 to %.0f.\n", optarg, kSndCtlMaxFadeMilliseconds);
+					return 1;
+				}
+
+				fadeDuration = (UInt64)(milliseconds * NSEC_PER_MSEC);
+				shouldFade = true;
 				break;
 			}
 			case 'vers':
@@ -428,7 +1410,7 @@ int main(int argc, const char * argv[]) {
 				return 0;
 				break;
 			case 'visu':
-				printAsSlider = true;
+				plan.printAsSlider = true;
 				break;
 		}
 	}
@@ -436,27 +1418,70 @@ int main(int argc, const char * argv[]) {
 //	argc -= optind;
 //	argv += optind;
 
-	if (!error) {
-		if (shouldSetBalance) {
-			if (balanceIsDelta)
-				SndCtlIncrementBalance(deviceid, balance, &error);
-			else
-				SndCtlSetBalance(deviceid, balance, &error);
-		}
+	if (shouldFade && switchDeviceID == kAudioDeviceUnknown) {
+		dprintf(STDERR_FILENO, "--fade can only be used with --switch.\n");
+		return 1;
+	}
 
-		if (shouldSetVolume) {
-			if (volumeIsDelta)
-				SndCtlIncrementVolume(deviceid, volume, &error);
-			else
-				SndCtlSetVolume(deviceid, volume, &error);
-		}
+	// --peek and --get print their own columns.
+	if (listFields && (!shouldList || shouldPeek || propertyGetCount > 0 || propertySetCount > 0)) {
+		dprintf(STDERR_FILENO, "--fields can only be used with -l, and not with --peek, --get or --set.\n");
+		return 1;
+	}
+
+	// Setting every device at once is too easy to do by accident, and can't be undone if it fails partway.
+	if (shouldList && propertySetCount > 0) {
+		dprintf(STDERR_FILENO, "--set can't be used with -l. Pick a device with -d.\n");
+		return 1;
+	}
+
+	// --peek matches against the published names, so it mustn't touch the HAL here.
+	if (shouldPeek)
+		return peekSharedState(plan.deviceid, deviceSelector, shouldList, plan.printAsSlider) ? 0 : 1;
+
+	if (deviceSelector) {
+		if (SndCtlHandleDeviceMatchingAndPrintErrors(deviceSelector, &plan.deviceid))
+			printf("Using device id %u.\n", plan.deviceid);
+		else
+			return 1;
+	}
+
+	if (shouldPublish)
+		return runStatePublisher() ? 0 : 1;
 
-		if (shouldPrintBalance)
-			printBalance(deviceid, printAsSlider, &error);
-		if (shouldPrintVolume)
-			printVolume(deviceid, printAsSlider, &error);
+	if (oscPort)
+		return runControlServer(oscPort) ? 0 : 1;
+
+	if (rulesPath)
+		return runRules(rulesPath) ? 0 : 1;
+
+	if (switchDeviceID != kAudioDeviceUnknown) {
+		if (!switchDefaultOutputDevice(switchDeviceID, fadeDuration))
+			return 1;
+
+		plan.newDefaultDeviceID = switchDeviceID;
 	}
 
+	if (propertyGetCount > 0 || propertySetCount > 0) {
+		if (!runPropertyQuery(plan.deviceid, shouldList, propertyGets, propertyGetCount, propertySets, propertySetValues, propertySetCount))
+			return 1;
+
+		return SndCtlHALAnyObjectUnresponsive() ? 2 : 0;
+	}
+
+	if (shouldList) {
+		bool listed = listFields ? listAudioOutputDevicesWithFields(listFields) : listAudioOutputDevices();
+
+		if (!listed)
+			return 1;
+
+		return SndCtlHALAnyObjectUnresponsive() ? 2 : 0;
+	}
+
+	// Some failures (like a device without a volume control) don't come with an error to print.
+	if (!error && !SndCtlCommandPlanRun(&plan, &error) && !error)
+		return 1;
+
 	if (error) {
 		SndCtlPrintError(error, true);
 		return 1;
@@ -465,5 +1490,9 @@ int main(int argc, const char * argv[]) {
 	if (shouldPrintUsage)
 		printUsage();
 
+	// Partial success: something was skipped because it didn't respond in time.
+	if (SndCtlHALAnyObjectUnresponsive())
+		return 2;
+
 	return 0;
 }
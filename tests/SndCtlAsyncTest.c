@@ -0,0 +1,167 @@
+//
+//  SndCtlAsyncTest.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+//  Queues requests on the default output device while its work queue is held up, and checks that
+//  superseded and cancelled requests complete with the right errors, in order, on the work queue
+//  rather than on the caller's thread. The only sets write back the device's current volume, so
+//  nothing audible changes. Run it with tests/run.sh async.
+//
+
+#include "SndCtlTestSupport.h"
+#include "SndCtlAsync.h"
+#include "SndCtlAudioUtils.h"
+#include "SndCtlError.h"
+#include <dispatch/dispatch.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+/// How long to wait for every handler to be called.
+#define kSndCtlAsyncTestTimeout	(5 * NSEC_PER_SEC)
+
+typedef struct {
+	const char *label;
+	/// The expected error code, or \c 0 for success.
+	CFIndex expectedCode;
+
+	bool called;
+	bool success;
+	CFIndex code;
+	bool onCallerThread;
+	/// Which handler call this was, counting from 1.
+	unsigned order;
+} SndCtlAsyncTestResult;
+
+static pthread_t gCallerThread;
+static unsigned gHandlerCount = 0;
+static dispatch_semaphore_t gHandlerCalled;
+/// Holds up the device's work queue until the requests under test are queued behind it.
+static dispatch_semaphore_t gBlockerStarted;
+static dispatch_semaphore_t gReleaseBlocker;
+
+static void SndCtlAsyncTestRecord(bool success, Float64 value, CFErrorRef error, void *context) {
+	SndCtlAsyncTestResult *result = context;
+
+	result->called = true;
+	result->success = success;
+	result->code = error ? CFErrorGetCode(error) : 0;
+	result->onCallerThread = pthread_equal(pthread_self(), gCallerThread);
+	result->order = __atomic_add_fetch(&gHandlerCount, 1, __ATOMIC_RELAXED);
+
+	dispatch_semaphore_signal(gHandlerCalled);
+}
+
+static void SndCtlAsyncTestBlock(bool success, Float64 value, CFErrorRef error, void *context) {
+	dispatch_semaphore_signal(gBlockerStarted);
+	dispatch_semaphore_wait(gReleaseBlocker, DISPATCH_TIME_FOREVER);
+
+	SndCtlAsyncTestRecord(success, value, error, context);
+}
+
+int main(int argc, char *argv[]) {
+	CFErrorRef error = NULL;
+	AudioObjectID deviceid = SndCtlDefaultOutputDeviceID(&error);
+
+	if (deviceid == kAudioDeviceUnknown) {
+		SndCtlTestPrintError("Couldn't get the default output device", error);
+		return EXIT_FAILURE;
+	}
+
+	if (!SndCtlOutputDeviceHasMainVolume(deviceid)) {
+		printf("Skipped: the default output device has no main volume.\n");
+		return EXIT_SUCCESS;
+	}
+
+	Float32 volume = SndCtlGetVolume(deviceid, &error);
+
+	if (isnan(volume)) {
+		SndCtlTestPrintError("Couldn't get the volume", error);
+		return EXIT_FAILURE;
+	}
+
+	gCallerThread = pthread_self();
+	gHandlerCalled = dispatch_semaphore_create(0);
+	gBlockerStarted = dispatch_semaphore_create(0);
+	gReleaseBlocker = dispatch_semaphore_create(0);
+
+	SndCtlAsyncTestResult results[] = {
+		{ "blocking get", 0 },
+		{ "superseded set", SndCtlErrorSuperseded },
+		{ "newest set", 0 },
+		{ "cancelled get", SndCtlErrorCancelled },
+	};
+	size_t resultCount = sizeof(results) / sizeof(results[0]);
+
+	// Handlers without a completion queue run on the device's work queue, so this holds it up.
+	SndCtlAsyncRequestRef requests[] = {
+		SndCtlGetVolumeAsync(deviceid, NULL, SndCtlAsyncTestBlock, &results[0]),
+		NULL,
+		NULL,
+		NULL,
+	};
+
+	dispatch_semaphore_wait(gBlockerStarted, DISPATCH_TIME_FOREVER);
+
+	requests[1] = SndCtlSetVolumeAsync(deviceid, volume, NULL, SndCtlAsyncTestRecord, &results[1]);
+	requests[2] = SndCtlSetVolumeAsync(deviceid, volume, NULL, SndCtlAsyncTestRecord, &results[2]);
+	requests[3] = SndCtlGetVolumeAsync(deviceid, NULL, SndCtlAsyncTestRecord, &results[3]);
+
+	int status = EXIT_SUCCESS;
+
+	if (!SndCtlAsyncRequestCancel(requests[3])) {
+		fprintf(stderr, "The queued get couldn't be cancelled.\n");
+		status = EXIT_FAILURE;
+	}
+
+	// The work queue is still held up, so nothing else can have been delivered yet.
+	for (size_t i = 1; i < resultCount; ++i) {
+		if (results[i].called) {
+			fprintf(stderr, "The %s's handler was called before the work queue got to it.\n", results[i].label);
+			status = EXIT_FAILURE;
+		}
+	}
+
+	dispatch_semaphore_signal(gReleaseBlocker);
+
+	for (size_t i = 0; i < resultCount; ++i) {
+		if (dispatch_semaphore_wait(gHandlerCalled, dispatch_time(DISPATCH_TIME_NOW, kSndCtlAsyncTestTimeout)) != 0) {
+			fprintf(stderr, "Only %zu of %zu handlers were called.\n", i, resultCount);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (size_t i = 0; i < resultCount; ++i) {
+		SndCtlAsyncTestResult *result = &results[i];
+		bool expectedSuccess = result->expectedCode == 0;
+
+		if (result->success != expectedSuccess || result->code != result->expectedCode) {
+			fprintf(stderr, "The %s finished with success %d and error %ld instead of %ld.\n", result->label, result->success, (long)result->code, (long)result->expectedCode);
+			status = EXIT_FAILURE;
+		}
+
+		if (result->onCallerThread) {
+			fprintf(stderr, "The %s's handler was called on the thread that made the request.\n", result->label);
+			status = EXIT_FAILURE;
+		}
+
+		if (result->order != i + 1) {
+			fprintf(stderr, "The %s's handler was called in position %u instead of %zu.\n", result->label, result->order, i + 1);
+			status = EXIT_FAILURE;
+		}
+
+		SndCtlAsyncRequestRelease(requests[i]);
+	}
+
+	dispatch_release(gHandlerCalled);
+	dispatch_release(gBlockerStarted);
+	dispatch_release(gReleaseBlocker);
+
+	if (status == EXIT_SUCCESS)
+		printf("%zu requests completed in order on the work queue.\n", resultCount);
+
+	return status;
+}
@@ -0,0 +1,147 @@
+//
+//  SndCtlBenchmark.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+//  Times device table enumeration on one thread and on the full pool, replaying a recording at its
+//  original speed and then with a fixed latency injected into every call to simulate a slow HAL.
+//  Run it with tests/run.sh benchmark.
+//
+
+#include "SndCtlTestSupport.h"
+#include "SndCtlHAL.h"
+#include "SndCtlParallel.h"
+#include <dispatch/dispatch.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+typedef struct {
+	const char *label;
+	double latencyScale;
+	UInt64 latency;
+} SndCtlBenchmarkCase;
+
+static const SndCtlBenchmarkCase kSndCtlBenchmarkCases[] = {
+	{ "recorded", 1.0, 0 },
+	{ "100 us", 0.0, 100 * NSEC_PER_USEC },
+	{ "1 ms", 0.0, NSEC_PER_MSEC },
+	{ "5 ms", 0.0, 5 * NSEC_PER_MSEC },
+};
+
+static void SndCtlBenchmarkUsage(void) {
+	fprintf(stderr, "usage: sndctl-benchmark [-n rounds] [-r log]\n");
+	exit(EX_USAGE);
+}
+
+// Returns the mean time of one enumeration in nanoseconds, or 0 on failure.
+static double SndCtlBenchmarkRun(const char *logPath, const SndCtlBenchmarkCase *benchmarkCase, unsigned threads, unsigned rounds) {
+	CFErrorRef error = NULL;
+
+	// Each round consumes one recorded enumeration, and the log holds exactly `rounds` of them.
+	if (!SndCtlHALStartReplay(logPath, benchmarkCase->latencyScale, &error)) {
+		SndCtlTestPrintError("Couldn't start replay", error);
+		return 0.0;
+	}
+
+	SndCtlHALSetReplayLatency(benchmarkCase->latency);
+	SndCtlParallelSetMaxThreads(threads);
+
+	UInt64 start = SndCtlTestNow();
+
+	for (unsigned i = 0; i < rounds; ++i) {
+		SndCtlDeviceTable *table = SndCtlDeviceTableCreate(kSndCtlTestAllFields, &error);
+
+		if (!table) {
+			SndCtlTestPrintError("Couldn't enumerate devices", error);
+			SndCtlParallelSetMaxThreads(0);
+			SndCtlHALSetReplayLatency(0);
+			SndCtlHALStop();
+			return 0.0;
+		}
+
+		SndCtlDeviceTableRelease(table);
+	}
+
+	UInt64 elapsed = SndCtlTestNow() - start;
+
+	SndCtlParallelSetMaxThreads(0);
+	SndCtlHALSetReplayLatency(0);
+	SndCtlHALStop();
+
+	return (double)elapsed / rounds;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned rounds = 20;
+	const char *logPath = NULL;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:r:")) != -1) {
+		switch (ch) {
+			case 'n': {
+				char *end;
+				unsigned long value = strtoul(optarg, &end, 10);
+
+				if (*optarg == '\0' || *end != '\0' || value == 0 || value > 100000)
+					SndCtlBenchmarkUsage();
+
+				rounds = (unsigned)value;
+				break;
+			}
+			case 'r':
+				logPath = optarg;
+				break;
+			default:
+				SndCtlBenchmarkUsage();
+		}
+	}
+
+	char recordedPath[] = "/tmp/sndctl-benchmark.XXXXXX";
+
+	if (!logPath) {
+		int fd = mkstemp(recordedPath);
+
+		if (fd == -1) {
+			perror("mkstemp");
+			return EXIT_FAILURE;
+		}
+
+		close(fd);
+		logPath = recordedPath;
+
+		CFIndex deviceCount = SndCtlTestRecordEnumerations(logPath, rounds, kSndCtlTestAllFields);
+
+		if (deviceCount < 0) {
+			unlink(recordedPath);
+			return EXIT_FAILURE;
+		}
+
+		printf("Recorded %u enumerations of %ld devices.\n", rounds, (long)deviceCount);
+	}
+
+	printf("latency   \t  serial ms\tparallel ms\tspeedup\n");
+
+	int status = EXIT_SUCCESS;
+
+	for (size_t i = 0; i < sizeof(kSndCtlBenchmarkCases) / sizeof(*kSndCtlBenchmarkCases); ++i) {
+		const SndCtlBenchmarkCase *benchmarkCase = &kSndCtlBenchmarkCases[i];
+		double serial = SndCtlBenchmarkRun(logPath, benchmarkCase, 1, rounds);
+		double parallel = serial > 0.0 ? SndCtlBenchmarkRun(logPath, benchmarkCase, 0, rounds) : 0.0;
+
+		if (parallel <= 0.0) {
+			status = EXIT_FAILURE;
+			break;
+		}
+
+		printf("%-10s\t%11.3f\t%11.3f\t%6.1fx\n", benchmarkCase->label, serial / 1e6, parallel / 1e6, serial / parallel);
+	}
+
+	if (logPath == recordedPath)
+		unlink(recordedPath);
+
+	return status;
+}
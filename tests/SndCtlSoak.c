@@ -0,0 +1,152 @@
+//
+//  SndCtlSoak.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+//  Builds and frees device tables over and over against the replay backend, and fails if the
+//  resident size keeps growing. Run it with tests/run.sh soak, which also checks for leaks.
+//
+
+#include "SndCtlTestSupport.h"
+#include "SndCtlHAL.h"
+#include <getopt.h>
+#include <sysexits.h>
+#include <mach/mach.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/// Enumerations recorded per replay; the replay is started over after this many.
+#define kSndCtlSoakBatch		1000
+/// Enumerations before the baseline resident size is taken, so one-time allocations settle.
+#define kSndCtlSoakWarmUp		20000
+/// How much the resident size may grow past the baseline.
+#define kSndCtlSoakRSSSlack		(1024 * 1024)
+
+static UInt64 SndCtlSoakResidentSize(void) {
+	mach_task_basic_info_data_t info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+		return 0;
+
+	return info.resident_size;
+}
+
+static void SndCtlSoakUsage(void) {
+	fprintf(stderr, "usage: sndctl-soak [-n enumerations] [-r log]\n");
+	exit(EX_USAGE);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long iterations = 1000000;
+	const char *logPath = NULL;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:r:")) != -1) {
+		switch (ch) {
+			case 'n': {
+				char *end;
+				iterations = strtoul(optarg, &end, 10);
+
+				if (*optarg == '\0' || *end != '\0' || iterations <= kSndCtlSoakWarmUp)
+					SndCtlSoakUsage();
+
+				break;
+			}
+			case 'r':
+				logPath = optarg;
+				break;
+			default:
+				SndCtlSoakUsage();
+		}
+	}
+
+	char recordedPath[] = "/tmp/sndctl-soak.XXXXXX";
+
+	if (!logPath) {
+		int fd = mkstemp(recordedPath);
+
+		if (fd == -1) {
+			perror("mkstemp");
+			return EXIT_FAILURE;
+		}
+
+		close(fd);
+		logPath = recordedPath;
+
+		if (SndCtlTestRecordEnumerations(logPath, kSndCtlSoakBatch, kSndCtlTestAllFields) < 0)
+			return EXIT_FAILURE;
+	}
+
+	CFErrorRef error = NULL;
+	CFIndex expectedCount = -1;
+	UInt64 baseline = 0;
+	UInt64 peak = 0;
+	int status = EXIT_SUCCESS;
+	UInt64 start = SndCtlTestNow();
+
+	for (unsigned long i = 0; i < iterations; ++i) {
+		if (i % kSndCtlSoakBatch == 0 && !SndCtlHALStartReplay(logPath, 0.0, &error)) {
+			SndCtlTestPrintError("Couldn't start replay", error);
+			status = EXIT_FAILURE;
+			break;
+		}
+
+		SndCtlDeviceTable *table = SndCtlDeviceTableCreate(kSndCtlTestAllFields, &error);
+
+		if (!table) {
+			fprintf(stderr, "Enumeration %lu failed. ", i);
+			SndCtlTestPrintError("Is the log short?", error);
+			status = EXIT_FAILURE;
+			break;
+		}
+
+		if (expectedCount < 0)
+			expectedCount = table->count;
+
+		if (table->count != expectedCount) {
+			fprintf(stderr, "Enumeration %lu found %ld devices instead of %ld.\n", i, (long)table->count, (long)expectedCount);
+			status = EXIT_FAILURE;
+		}
+
+		SndCtlDeviceTableRelease(table);
+
+		if (status != EXIT_SUCCESS)
+			break;
+
+		if (i + 1 == kSndCtlSoakWarmUp) {
+			baseline = SndCtlSoakResidentSize();
+		} else if (i >= kSndCtlSoakWarmUp && (i + 1) % 100000 == 0) {
+			UInt64 rss = SndCtlSoakResidentSize();
+
+			if (rss > peak)
+				peak = rss;
+
+			printf("%8lu enumerations: %llu KiB resident\n", i + 1, rss / 1024);
+		}
+	}
+
+	SndCtlHALStop();
+
+	if (logPath == recordedPath)
+		unlink(recordedPath);
+
+	if (status != EXIT_SUCCESS)
+		return status;
+
+	UInt64 end = SndCtlSoakResidentSize();
+
+	if (end > peak)
+		peak = end;
+
+	printf("%lu enumerations of %ld devices in %.1f s; resident size %llu KiB after warm-up, %llu KiB peak.\n", iterations, (long)expectedCount, (SndCtlTestNow() - start) / 1e9, baseline / 1024, peak / 1024);
+
+	if (peak > baseline + kSndCtlSoakRSSSlack) {
+		fprintf(stderr, "Resident size grew by %llu KiB.\n", (peak - baseline) / 1024);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,57 @@
+//
+//  SndCtlTestSupport.c
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#include "SndCtlTestSupport.h"
+#include "SndCtlHAL.h"
+#include <time.h>
+
+UInt64 SndCtlTestNow(void) {
+	return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+void SndCtlTestPrintError(const char *message, CFErrorRef error) {
+	if (!error) {
+		fprintf(stderr, "%s\n", message);
+		return;
+	}
+
+	CFStringRef description = CFErrorCopyDescription(error);
+	char buffer[512] = "";
+	CFStringGetCString(description, buffer, sizeof(buffer), kCFStringEncodingUTF8);
+	fprintf(stderr, "%s: %s\n", message, buffer);
+	CFRelease(description);
+	CFRelease(error);
+}
+
+CFIndex SndCtlTestRecordEnumerations(const char *path, unsigned count, SndCtlDeviceField fields) {
+	CFErrorRef error = NULL;
+
+	if (!SndCtlHALStartRecording(path, &error)) {
+		SndCtlTestPrintError("Couldn't start recording", error);
+		return -1;
+	}
+
+	CFIndex deviceCount = -1;
+
+	for (unsigned i = 0; i < count; ++i) {
+		SndCtlDeviceTable *table = SndCtlDeviceTableCreate(fields, &error);
+
+		if (!table) {
+			SndCtlTestPrintError("Couldn't enumerate devices", error);
+			deviceCount = -1;
+			break;
+		}
+
+		deviceCount = table->count;
+		SndCtlDeviceTableRelease(table);
+	}
+
+	SndCtlHALStop();
+
+	return deviceCount;
+}
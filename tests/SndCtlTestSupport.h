@@ -0,0 +1,39 @@
+//
+//  SndCtlTestSupport.h
+//  sndctl
+//
+//  Created by Nate Weaver on 2026-10-19.
+//  Copyright © 2026 Nate Weaver/Derailer. All rights reserved.
+//
+
+#ifndef SndCtlTestSupport_h
+#define SndCtlTestSupport_h
+
+#include <stdio.h>
+#include "SndCtlDeviceTable.h"
+
+/// Every attribute a device table can hold, leaving out the folded strings only selectors need.
+#define kSndCtlTestAllFields	((SndCtlDeviceField)((SndCtlDeviceFieldStatus << 1) - 1))
+
+/**
+ Get a monotonic timestamp in nanoseconds.
+ */
+UInt64 SndCtlTestNow(void);
+
+/**
+ Record some device table enumerations against the live HAL, for replaying later.
+ @param path	The path of the log to write.
+ @param count	The number of enumerations to record.
+ @param fields	The attributes to fetch in each enumeration.
+ @return The number of devices in the last enumeration, or \c -1 on failure (after printing why).
+ @discussion Replays consume the records they use, so a log can answer \c count enumerations
+ 	before the replay has to be started over.
+ */
+CFIndex SndCtlTestRecordEnumerations(const char *path, unsigned count, SndCtlDeviceField fields);
+
+/**
+ Print an error and release it.
+ */
+void SndCtlTestPrintError(const char *message, CFErrorRef error);
+
+#endif /* SndCtlTestSupport_h */
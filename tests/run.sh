@@ -0,0 +1,41 @@
+#!/bin/sh
+#
+# Builds and runs sndctl's soak test or benchmark against the replay backend, or the
+# asynchronous API test against the default output device.
+#
+# usage: tests/run.sh soak [-n enumerations] [-r log]
+#        tests/run.sh benchmark [-n rounds] [-r log]
+#        tests/run.sh async
+#
+# Without -r, a short log is recorded from this Mac's devices first; nothing is changed.
+# The soak test runs under leaks(1), so any leaked allocation fails it. The async test only
+# writes back the default device's current volume.
+#
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+build="${TMPDIR:-/tmp}/sndctl-tests"
+mkdir -p "$build"
+
+test="$1"
+[ $# -gt 0 ] && shift
+
+case "$test" in
+	soak) main=tests/SndCtlSoak.c ;;
+	benchmark) main=tests/SndCtlBenchmark.c ;;
+	async) main=tests/SndCtlAsyncTest.c ;;
+	*) echo "usage: $0 soak|benchmark|async [options]" >&2; exit 64 ;;
+esac
+
+sources=$(ls sndctl/*.c | grep -v '/main\.c$')
+
+xcrun clang -std=gnu99 -O2 -g -Wall -Isndctl -Itests \
+	-framework CoreAudio -framework AudioToolbox -framework CoreFoundation \
+	-o "$build/sndctl-$test" $sources tests/SndCtlTestSupport.c "$main"
+
+case "$test" in
+	soak) exec leaks --atExit -- "$build/sndctl-$test" "$@" ;;
+	*) exec "$build/sndctl-$test" "$@" ;;
+esac